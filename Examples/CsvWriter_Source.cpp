@@ -0,0 +1,18 @@
+#define SFL_CSVWRITER
+#include "SFL.h"
+
+int main()
+{
+	sfl::CsvWriter writer;
+
+	// Full buffers are written on another thread
+	if (!writer.Open("prices.csv", true))
+		return 1;
+
+	writer.WriteRow("name", "price", "note");
+
+	for (int i = 0; i < 1000; i++)
+		writer.WriteRow("item" + std::to_string(i), i * 0.25, i % 2 ? "odd, \"quoted\"" : "even");
+
+	return writer.Close() ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#include <iostream>
+#include <thread>
+
+#define SFL_DATAFILEWATCHER
+#include "SFL.h"
+
+int main()
+{
+	sfl::DataFile df;
+	df["Info"]["Level"].SetInt(1);
+	sfl::DataFile::Write(df, "config.df");
+
+	sfl::DataFileWatcher watcher;
+
+	watcher.OnChange("Info/Level", [](const sfl::DataFile& dfNew, const std::vector<sfl::DataFileWatcher::Change>&)
+		{
+			if (auto pLevel = dfNew.Find(sfl::DataFile::Path("Info/Level")))
+				std::cout << "Level: " << pLevel->Int() << std::endl;
+		});
+
+	if (!watcher.Start("config.df"))
+		return 1;
+
+	df["Info"]["Level"].SetInt(2);
+	sfl::DataFile::Write(df, "config.df");
+
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+
+	// Snapshot stays valid even if the file is reloaded meanwhile
+	auto pConfig = watcher.Get();
+	std::cout << "Current level: " << (*pConfig).Find("Info")->Find("Level")->Int() << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+#include <iostream>
+#include <vector>
+
+#define SFL_THREADPOOL
+#include "SFL.h"
+
+int main()
+{
+	sfl::ThreadPool pool;
+
+	std::vector<int> vecSquares(1000);
+
+	pool.ParallelFor(0, vecSquares.size(), [&](size_t i)
+		{
+			vecSquares[i] = int(i * i);
+		});
+
+	auto handle = pool.Submit([&]()
+		{
+			long long nSum = 0;
+
+			for (int n : vecSquares)
+				nSum += n;
+
+			return nSum;
+		});
+
+	std::cout << "Sum: " << handle.Get() << std::endl;
+
+	return 0;
+}
@@ -33,14 +33,599 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <memory>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
 
 #pragma endregion
 
 namespace sfl
 {
+	namespace detail
+	{
+		inline int CsvTrailingZeros(uint64_t nMask)
+		{
+#if defined(_MSC_VER)
+			unsigned long nIndex;
+			_BitScanForward64(&nIndex, nMask);
+			return (int)nIndex;
+#else
+			return __builtin_ctzll(nMask);
+#endif
+		}
+
+		// Marks positions of up to four characters in a 64 byte block,
+		// so the tokenizer jumps from one special character to another
+		// instead of looking at every byte
+		class CsvScanner
+		{
+		public:
+			CsvScanner(char c1, char c2, char c3, char c4) : m_arrChars{ c1, c2, c3, c4 }
+			{
+				for (char c : m_arrChars)
+					m_arrSpecial[(uint8_t)c] = 1;
+			}
+
+			// 64 bytes must be readable from pBlock
+			uint64_t Mask(const char* pBlock) const
+			{
+#if defined(__AVX2__)
+				const __m256i v1 = _mm256_set1_epi8(m_arrChars[0]);
+				const __m256i v2 = _mm256_set1_epi8(m_arrChars[1]);
+				const __m256i v3 = _mm256_set1_epi8(m_arrChars[2]);
+				const __m256i v4 = _mm256_set1_epi8(m_arrChars[3]);
+
+				auto Half = [&](const char* p)
+				{
+					__m256i v = _mm256_loadu_si256((const __m256i*)p);
+
+					__m256i vMatch = _mm256_or_si256(
+						_mm256_or_si256(_mm256_cmpeq_epi8(v, v1), _mm256_cmpeq_epi8(v, v2)),
+						_mm256_or_si256(_mm256_cmpeq_epi8(v, v3), _mm256_cmpeq_epi8(v, v4)));
+
+					return (uint64_t)(uint32_t)_mm256_movemask_epi8(vMatch);
+				};
+
+				return Half(pBlock) | (Half(pBlock + 32) << 32);
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+				const __m128i v1 = _mm_set1_epi8(m_arrChars[0]);
+				const __m128i v2 = _mm_set1_epi8(m_arrChars[1]);
+				const __m128i v3 = _mm_set1_epi8(m_arrChars[2]);
+				const __m128i v4 = _mm_set1_epi8(m_arrChars[3]);
+
+				uint64_t nMask = 0;
+
+				for (int i = 0; i < 64; i += 16)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i*)(pBlock + i));
+
+					__m128i vMatch = _mm_or_si128(
+						_mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)),
+						_mm_or_si128(_mm_cmpeq_epi8(v, v3), _mm_cmpeq_epi8(v, v4)));
+
+					nMask |= (uint64_t)(uint16_t)_mm_movemask_epi8(vMatch) << i;
+				}
+
+				return nMask;
+#else
+				uint64_t nMask = 0;
+
+				for (int i = 0; i < 64; i++)
+					nMask |= (uint64_t)m_arrSpecial[(uint8_t)pBlock[i]] << i;
+
+				return nMask;
+#endif
+			}
+
+			// For the last block that is shorter than 64 bytes
+			uint64_t Mask(const char* pBlock, size_t nSize) const
+			{
+				uint64_t nMask = 0;
+
+				for (size_t i = 0; i < nSize; i++)
+					nMask |= (uint64_t)m_arrSpecial[(uint8_t)pBlock[i]] << i;
+
+				return nMask;
+			}
+
+		private:
+			char m_arrChars[4];
+			uint8_t m_arrSpecial[256]{};
+
+		};
+
+		// Where the tokenizer is between two characters
+		enum class CsvSplitState : uint8_t
+		{
+			FieldStart,  // quote would open a value
+			Field,       // quote is a part of the value
+			Quoted,      // inside quotes
+			QuotedSkip,  // inside quotes and the next character is escaped
+			Count
+		};
+
+		// Same rules as in CsvReader::Tokenize: a quote opens a value only at
+		// its beginning, after the closing quote the rest of the value is text
+		inline CsvSplitState CsvSplitStep(CsvSplitState state, const char* pData, size_t i, size_t nSize, char cDelimiter, char cQuote, char cEscape, bool bTrim)
+		{
+			char c = pData[i];
+
+			switch (state)
+			{
+			case CsvSplitState::QuotedSkip:
+				return CsvSplitState::Quoted;
+
+			case CsvSplitState::Quoted:
+				if (c == cEscape && cEscape != cQuote)
+					return CsvSplitState::QuotedSkip;
+
+				if (c == cQuote)
+				{
+					// Two quotes are one quote
+					if (cEscape == cQuote && i + 1 < nSize && pData[i + 1] == cQuote)
+						return CsvSplitState::QuotedSkip;
+
+					return CsvSplitState::Field;
+				}
+
+				return CsvSplitState::Quoted;
+
+			default:
+				if (c == cDelimiter || c == '\n')
+					return CsvSplitState::FieldStart;
+
+				if (state == CsvSplitState::FieldStart)
+				{
+					if (c == cQuote && cQuote != 0)
+						return CsvSplitState::Quoted;
+
+					if (bTrim && (c == ' ' || c == '\t'))
+						return CsvSplitState::FieldStart;
+				}
+
+				return CsvSplitState::Field;
+			}
+		}
+
+		// Cuts the buffer into about nParts ranges that start at the beginning of
+		// a row. A new line inside quotes doesn't end a row, and whether a quote
+		// opens them depends on what was before it, so every range is first run
+		// from each state the tokenizer can be in. Then the real state at the start
+		// of each range is known in order, and each range moves its start to the
+		// first new line outside of quotes. cQuote == 0 means there are no quotes
+		inline std::vector<size_t> CsvSplitRows(const char* pData, size_t nSize, size_t nParts, char cDelimiter, char cQuote, char cEscape, bool bTrim, ThreadPool& pool)
+		{
+			constexpr size_t nStates = (size_t)CsvSplitState::Count;
+
+			nParts = std::max<size_t>(1, std::min(nParts, nSize / 4096 + 1));
+
+			std::vector<size_t> vecStarts(nParts + 1);
+
+			for (size_t i = 0; i <= nParts; i++)
+				vecStarts[i] = nSize / nParts * i;
+
+			vecStarts[nParts] = nSize;
+
+			// State at the end of the range for each state at its start
+			std::vector<std::array<CsvSplitState, nStates>> vecEnds(nParts);
+
+			if (cQuote != 0)
+			{
+				pool.ParallelFor(0, nParts,
+					[&](size_t i)
+					{
+						std::array<CsvSplitState, nStates> arrStates;
+
+						for (size_t s = 0; s < nStates; s++)
+							arrStates[s] = (CsvSplitState)s;
+
+						for (size_t nPos = vecStarts[i]; nPos < vecStarts[i + 1]; nPos++)
+						{
+							for (auto& state : arrStates)
+								state = CsvSplitStep(state, pData, nPos, nSize, cDelimiter, cQuote, cEscape, bTrim);
+						}
+
+						vecEnds[i] = arrStates;
+					}, 1);
+			}
+
+			std::vector<CsvSplitState> vecStates(nParts, CsvSplitState::FieldStart);
+
+			if (cQuote != 0)
+			{
+				for (size_t i = 1; i < nParts; i++)
+					vecStates[i] = vecEnds[i - 1][(size_t)vecStates[i - 1]];
+			}
+
+			std::vector<size_t> vecSplits(nParts + 1);
+			vecSplits[0] = 0;
+			vecSplits[nParts] = nSize;
+
+			pool.ParallelFor(1, nParts,
+				[&](size_t i)
+				{
+					CsvSplitState state = vecStates[i];
+					size_t nPos = vecStarts[i];
+
+					for (; nPos < nSize; nPos++)
+					{
+						bool bQuoted = state == CsvSplitState::Quoted || state == CsvSplitState::QuotedSkip;
+
+						if (pData[nPos] == '\n' && !bQuoted)
+							break;
+
+						state = CsvSplitStep(state, pData, nPos, nSize, cDelimiter, cQuote, cEscape, bTrim);
+					}
+
+					vecSplits[i] = std::min(nPos + 1, nSize);
+				}, 1);
+
+			// Ranges that found the same row start are empty then
+			for (size_t i = 1; i <= nParts; i++)
+				vecSplits[i] = std::max(vecSplits[i], vecSplits[i - 1]);
+
+			return vecSplits;
+		}
+	}
+
+	// How the file is written, default is RFC 4180
+	struct CsvDialect
+	{
+		enum class Trim
+		{
+			// Values are kept as they are
+			None,
+
+			// Spaces and tabs around values without quotes are removed
+			Unquoted,
+
+			// ... and inside quotes too
+			All
+		};
+
+		char cDelimiter = ',';
+
+		// 0 means that quotes are ordinary characters
+		char cQuote = '"';
+
+		// Character that makes the next one inside quotes a plain character,
+		// when it's the quote itself a quote is written as two quotes
+		char cEscape = '"';
+
+		// First row has names of the columns
+		bool bHeader = false;
+
+		Trim trim = Trim::None;
+	};
+
 	class CsvReader
 	{
+	public:
+		// Rows keeps every cell on its own, Columns keeps
+		// all values of a column together in one buffer
+		enum class Storage
+		{
+			Rows,
+			Columns
+		};
+
+		class Column
+		{
+		public:
+			// Column becomes Int or Double if every value in it is a number
+			// or empty (null). Numbers with leading zeros (like zip codes), nan
+			// and inf keep it a String. Found types keep the text of values
+			// that numbers don't give back (1.50, 1e3), types given by a schema don't
+			enum class Type
+			{
+				String,
+				Int,
+				Double,
+
+				// Only for a schema: type is found from the values
+				Auto
+			};
+
+		public:
+			Type GetType() const
+			{
+				return m_type;
+			}
+
+			size_t Size() const
+			{
+				switch (m_type)
+				{
+				case Type::Int: return m_vecInts.size();
+				case Type::Double: return m_vecDoubles.size();
+				default: return m_vecOffsets.size() - 1;
+				}
+			}
+
+			// Only for String columns
+			std::string_view View(size_t nRow) const
+			{
+				return std::string_view(m_sData).substr(m_vecOffsets[nRow], m_vecOffsets[nRow + 1] - m_vecOffsets[nRow]);
+			}
+
+			std::string String(size_t nRow) const
+			{
+				char buf[32];
+
+				if (m_type != Type::String)
+				{
+					if (IsError(nRow))
+						return std::lower_bound(m_vecBadValues.begin(), m_vecBadValues.end(), std::make_pair(nRow, std::string()))->second;
+
+					if (IsNull(nRow))
+						return {};
+
+					auto it = std::lower_bound(m_vecTexts.begin(), m_vecTexts.end(), std::make_pair(nRow, std::string()));
+
+					if (it != m_vecTexts.end() && it->first == nRow)
+						return it->second;
+				}
+
+				switch (m_type)
+				{
+				case Type::Int: return std::string(buf, std::to_chars(buf, buf + sizeof(buf), m_vecInts[nRow]).ptr);
+				case Type::Double: return std::string(buf, std::to_chars(buf, buf + sizeof(buf), m_vecDoubles[nRow]).ptr);
+				default: return std::string(View(nRow));
+				}
+			}
+
+			long long Int(size_t nRow) const
+			{
+				switch (m_type)
+				{
+				case Type::Int: return m_vecInts[nRow];
+				case Type::Double: return (long long)m_vecDoubles[nRow];
+				default: return std::stoll(String(nRow));
+				}
+			}
+
+			double Double(size_t nRow) const
+			{
+				switch (m_type)
+				{
+				case Type::Int: return (double)m_vecInts[nRow];
+				case Type::Double: return m_vecDoubles[nRow];
+				default: return std::stod(String(nRow));
+				}
+			}
+
+			// Values of typed columns lie one after another,
+			// so they can be scanned without any conversion.
+			// Nulls and bad values are zeros there
+			const std::vector<long long>& Ints() const
+			{
+				return m_vecInts;
+			}
+
+			const std::vector<double>& Doubles() const
+			{
+				return m_vecDoubles;
+			}
+
+			// Empty value
+			bool IsNull(size_t nRow) const
+			{
+				if (m_type == Type::String)
+					return View(nRow).empty();
+
+				return TestBit(m_vecNulls, nRow);
+			}
+
+			// Value that isn't a number of the column type (only when the type
+			// is given by a schema), its text is still returned by String
+			bool IsError(size_t nRow) const
+			{
+				return TestBit(m_vecErrors, nRow);
+			}
+
+			size_t NullCount() const
+			{
+				return m_nNulls;
+			}
+
+			size_t ErrorCount() const
+			{
+				return m_vecBadValues.size();
+			}
+
+			// Bit (i % 64) of word (i / 64) is set for the row i, so queries
+			// can skip nulls and errors of typed columns 64 rows at a time
+			const std::vector<uint64_t>& NullBits() const
+			{
+				return m_vecNulls;
+			}
+
+			const std::vector<uint64_t>& ErrorBits() const
+			{
+				return m_vecErrors;
+			}
+
+		private:
+			friend class CsvReader;
+
+			void Append(std::string_view sValue)
+			{
+				m_sData += sValue;
+				m_vecOffsets.push_back(m_sData.size());
+			}
+
+			static bool TestBit(const std::vector<uint64_t>& vecBits, size_t i)
+			{
+				return i / 64 < vecBits.size() && (vecBits[i / 64] >> (i % 64)) & 1;
+			}
+
+			static void SetBit(std::vector<uint64_t>& vecBits, size_t i)
+			{
+				vecBits[i / 64] |= uint64_t(1) << (i % 64);
+			}
+
+			// Returns the row with the first bad value if bStrict, then numbers
+			// with leading zeros, nan and inf are bad too, and the text of numbers
+			// that to_chars writes differently is kept aside.
+			// Otherwise bad values are kept aside and marked as errors
+			template <typename T>
+			size_t ParseValues(std::vector<T>& vecOut, bool bStrict)
+			{
+				size_t nCount = m_vecOffsets.size() - 1;
+
+				vecOut.resize(nCount);
+				m_vecNulls.assign((nCount + 63) / 64, 0);
+				m_vecErrors.assign((nCount + 63) / 64, 0);
+				m_vecBadValues.clear();
+				m_vecTexts.clear();
+				m_nNulls = 0;
+
+				for (size_t i = 0; i < nCount; i++)
+				{
+					const char* pBegin = m_sData.data() + m_vecOffsets[i];
+					const char* pEnd = m_sData.data() + m_vecOffsets[i + 1];
+
+					if (pBegin == pEnd)
+					{
+						vecOut[i] = T();
+						SetBit(m_vecNulls, i);
+						m_nNulls++;
+						continue;
+					}
+
+					auto [p, ec] = std::from_chars(pBegin, pEnd, vecOut[i]);
+
+					if (ec == std::errc() && p == pEnd && (!bStrict || IsPlainNumber(pBegin, pEnd, vecOut[i])))
+					{
+						if (bStrict)
+						{
+							char buf[32];
+							char* pText = std::to_chars(buf, buf + sizeof(buf), vecOut[i]).ptr;
+
+							if (std::string_view(buf, pText - buf) != std::string_view(pBegin, pEnd - pBegin))
+								m_vecTexts.emplace_back(i, std::string(pBegin, pEnd));
+						}
+
+						continue;
+					}
+
+					if (bStrict)
+						return i;
+
+					vecOut[i] = T();
+					SetBit(m_vecErrors, i);
+					m_vecBadValues.emplace_back(i, std::string(pBegin, pEnd));
+				}
+
+				return nCount;
+			}
+
+			// 0 and 0.5 are fine, 00501 isn't
+			template <typename T>
+			static bool IsPlainNumber(const char* pBegin, const char* pEnd, T value)
+			{
+				if (*pBegin == '-')
+					pBegin++;
+
+				if (pEnd - pBegin > 1 && pBegin[0] == '0' && pBegin[1] >= '0' && pBegin[1] <= '9')
+					return false;
+
+				if constexpr (std::is_floating_point_v<T>)
+					return std::isfinite(value);
+				else
+					return true;
+			}
+
+			void SetType(Type type)
+			{
+				switch (type)
+				{
+				case Type::Int: ParseValues(m_vecInts, false); break;
+				case Type::Double: ParseValues(m_vecDoubles, false); break;
+				case Type::Auto: DetectType(); return;
+				default: return;
+				}
+
+				EndParse(type);
+			}
+
+			void DetectType()
+			{
+				size_t nCount = Size();
+
+				if (ParseValues(m_vecInts, true) == nCount && m_nNulls < nCount)
+				{
+					EndParse(Type::Int);
+					return;
+				}
+
+				m_vecInts = std::vector<long long>();
+
+				if (ParseValues(m_vecDoubles, true) == nCount && m_nNulls < nCount)
+				{
+					EndParse(Type::Double);
+					return;
+				}
+
+				// It's text after all
+				m_vecDoubles = std::vector<double>();
+				m_vecNulls = std::vector<uint64_t>();
+				m_vecErrors = std::vector<uint64_t>();
+				m_vecTexts = std::vector<std::pair<size_t, std::string>>();
+				m_nNulls = 0;
+			}
+
+			void EndParse(Type type)
+			{
+				m_type = type;
+
+				// Numbers are enough now
+				m_sData = std::string();
+				m_vecOffsets = std::vector<size_t>{ 0 };
+			}
+
+		private:
+			Type m_type = Type::String;
+
+			// Value i is m_sData[m_vecOffsets[i], m_vecOffsets[i + 1])
+			std::string m_sData;
+			std::vector<size_t> m_vecOffsets{ 0 };
+
+			std::vector<long long> m_vecInts;
+			std::vector<double> m_vecDoubles;
+
+			std::vector<uint64_t> m_vecNulls;
+			std::vector<uint64_t> m_vecErrors;
+			size_t m_nNulls = 0;
+
+			// Text of bad values sorted by rows
+			std::vector<std::pair<size_t, std::string>> m_vecBadValues;
+
+			// Text of found numbers that String wouldn't give back (1.50, 1e3),
+			// sorted by rows, the rest is written from the numbers
+			std::vector<std::pair<size_t, std::string>> m_vecTexts;
+
+		};
+
 	public:
 		CsvReader() = default;
 		CsvReader(std::string sFileName)
@@ -50,43 +635,303 @@ namespace sfl
 		}
 
 	private:
-		std::ifstream m_ifCsvFile;
 		std::string m_sFileName;
 
-		struct Cell
+		Storage m_storage = Storage::Rows;
+		CsvDialect m_dialect;
+
+		std::vector<Column::Type> m_vecSchema;
+		std::vector<std::pair<std::string, Column::Type>> m_vecNamedTypes;
+
+		std::vector<std::string> m_vecHeader;
+		bool m_bInHeader = false;
+
+		// Storage::Rows: all cells one after another in one buffer,
+		// cell i is m_sCells[m_vecCellOffsets[i], m_vecCellOffsets[i + 1])
+		// and cells of row r are [m_vecRowOffsets[r], m_vecRowOffsets[r + 1])
+		std::string m_sCells;
+		std::vector<size_t> m_vecCellOffsets{ 0 };
+		std::vector<size_t> m_vecRowOffsets{ 0 };
+
+		std::vector<Column> m_vecColumns;
+		size_t m_nRows = 0;
+		size_t m_nCols = 0;
+
+		// Index of the next field in the row that is being loaded
+		size_t m_nField = 0;
+
+	public:
+		// Cells of one row, a missing cell is an empty view
+		class RowView
 		{
-			int nRow;
-			int nCol;
+		public:
+			RowView(const CsvReader* pReader, size_t nRow) : m_pReader(pReader), m_nRow(nRow) {}
+
+			class iterator
+			{
+			public:
+				iterator(const RowView* pRow, size_t nCol) : m_pRow(pRow), m_nCol(nCol) {}
+
+				std::string_view operator*() const { return (*m_pRow)[m_nCol]; }
+				iterator& operator++() { m_nCol++; return *this; }
+				bool operator!=(const iterator& it) const { return m_nCol != it.m_nCol; }
+
+			private:
+				const RowView* m_pRow;
+				size_t m_nCol;
+
+			};
+
+		public:
+			size_t Size() const
+			{
+				return m_pReader->GetRowSize(m_nRow);
+			}
+
+			std::string_view operator[](size_t nCol) const
+			{
+				return m_pReader->GetView(m_nRow, nCol);
+			}
+
+			iterator begin() const { return iterator(this, 0); }
+			iterator end() const { return iterator(this, Size()); }
+
+		private:
+			const CsvReader* m_pReader;
+			size_t m_nRow;
 
-			std::string sValue;
 		};
 
-		std::vector<Cell> m_vecCells;
+		// Cells of one column going down through all rows
+		class ColumnView
+		{
+		public:
+			ColumnView(const CsvReader* pReader, size_t nCol) : m_pReader(pReader), m_nCol(nCol) {}
+
+			class iterator
+			{
+			public:
+				iterator(const ColumnView* pColumn, size_t nRow) : m_pColumn(pColumn), m_nRow(nRow) {}
+
+				std::string_view operator*() const { return (*m_pColumn)[m_nRow]; }
+				iterator& operator++() { m_nRow++; return *this; }
+				bool operator!=(const iterator& it) const { return m_nRow != it.m_nRow; }
+
+			private:
+				const ColumnView* m_pColumn;
+				size_t m_nRow;
+
+			};
 
-		void Split(std::string sInput, std::vector<std::string>* vecOutput)
+		public:
+			size_t Size() const
+			{
+				return m_pReader->m_nRows;
+			}
+
+			std::string_view operator[](size_t nRow) const
+			{
+				return m_pReader->GetView(nRow, m_nCol);
+			}
+
+			iterator begin() const { return iterator(this, 0); }
+			iterator end() const { return iterator(this, Size()); }
+
+		private:
+			const CsvReader* m_pReader;
+			size_t m_nCol;
+
+		};
+
+		// Reads the file through a buffer of fixed size (it grows only if one
+		// row doesn't fit), so only a window of the file is kept in memory.
+		// Row given by the iterator is valid until the iterator moves
+		class RowStream
 		{
-			std::string s;
+		public:
+			RowStream(const std::string& sFileName, const CsvDialect& dialect, size_t nBufferSize)
+				: m_file(sFileName, std::ios::binary), m_vecBuffer(std::max<size_t>(nBufferSize, 64)), m_pWindow(std::make_unique<CsvReader>())
+			{
+				m_pWindow->SetDialect(dialect);
+			}
 
-			for (int c = 0; c < sInput.length(); c++)
+			class iterator
 			{
-				switch (sInput[c])
+			public:
+				iterator(RowStream* pStream) : m_pStream(pStream) {}
+
+				RowView operator*() const
+				{
+					return m_pStream->m_pWindow->GetRow(m_pStream->m_nRow);
+				}
+
+				iterator& operator++()
 				{
-				case ',':
+					if (!m_pStream->Next())
+						m_pStream = nullptr;
+
+					return *this;
+				}
+
+				bool operator!=(const iterator& it) const
 				{
-					vecOutput->push_back(s);
-					s.clear();
+					return m_pStream != it.m_pStream;
 				}
-				break;
 
-				case ' ':
-					break;
+			private:
+				RowStream* m_pStream;
+
+			};
+
+		public:
+			bool IsOpen() const
+			{
+				return m_file.is_open();
+			}
+
+			iterator begin()
+			{
+				return iterator(Next() ? this : nullptr);
+			}
+
+			iterator end()
+			{
+				return iterator(nullptr);
+			}
+
+			// Available after the first row is read
+			const std::vector<std::string>& GetHeader() const
+			{
+				return m_vecHeader;
+			}
 
-				default:
-					s.push_back(sInput[c]);
+		private:
+			bool Next()
+			{
+				m_nRow++;
+
+				while (m_nRow >= (size_t)m_pWindow->GetTotalRows())
+				{
+					if (!Fill())
+						return false;
+
+					m_nRow = 0;
 				}
+
+				return true;
 			}
 
-		}
+			// Tokenizes the next piece of whole rows into the window
+			bool Fill()
+			{
+				if (m_bEnd || !m_file.is_open())
+					return false;
+
+				while (true)
+				{
+					m_file.read(m_vecBuffer.data() + m_nUsed, std::streamsize(m_vecBuffer.size() - m_nUsed));
+					m_nUsed += size_t(m_file.gcount());
+
+					size_t nRows = m_nUsed;
+
+					if (m_file)
+					{
+						// The rest of the last row stays for the next time
+						nRows = RowsEnd(m_vecBuffer.data(), m_nUsed);
+
+						if (nRows == 0)
+						{
+							m_vecBuffer.resize(m_vecBuffer.size() * 2);
+							continue;
+						}
+					}
+					else
+						m_bEnd = true;
+
+					m_pWindow->Clear();
+					m_pWindow->Tokenize(m_vecBuffer.data(), nRows);
+
+					// Header is only in the first piece
+					if (m_pWindow->m_dialect.bHeader)
+					{
+						m_vecHeader = std::move(m_pWindow->m_vecHeader);
+						m_pWindow->m_dialect.bHeader = false;
+					}
+
+					m_nUsed -= nRows;
+					memmove(m_vecBuffer.data(), m_vecBuffer.data() + nRows, m_nUsed);
+
+					return true;
+				}
+			}
+
+			// Position after the last new line that isn't inside quotes
+			size_t RowsEnd(const char* pData, size_t nSize) const
+			{
+				const CsvDialect& d = m_pWindow->m_dialect;
+
+				if (d.cQuote == 0)
+				{
+					while (nSize > 0 && pData[nSize - 1] != '\n')
+						nSize--;
+
+					return nSize;
+				}
+
+				// Same rules as in Tokenize: quote opens a value only at its beginning
+				size_t nEnd = 0;
+				bool bInQuotes = false;
+				bool bFieldStart = true;
+
+				for (size_t i = 0; i < nSize; i++)
+				{
+					char c = pData[i];
+
+					if (bInQuotes)
+					{
+						if (c == d.cEscape && d.cEscape != d.cQuote)
+							i++;
+						else if (c == d.cQuote)
+						{
+							if (d.cEscape == d.cQuote && i + 1 < nSize && pData[i + 1] == d.cQuote)
+								i++;
+							else
+								bInQuotes = false;
+						}
+					}
+					else if (c == d.cQuote && bFieldStart)
+					{
+						bInQuotes = true;
+						bFieldStart = false;
+					}
+					else if (c == d.cDelimiter || c == '\n')
+					{
+						bFieldStart = true;
+
+						if (c == '\n')
+							nEnd = i + 1;
+					}
+					else if (d.trim == CsvDialect::Trim::None || !IsBlank(c))
+						bFieldStart = false;
+				}
+
+				return nEnd;
+			}
+
+		private:
+			std::ifstream m_file;
+
+			std::vector<char> m_vecBuffer;
+			size_t m_nUsed = 0;
+			bool m_bEnd = false;
+
+			// Rows of the current piece of the file
+			std::unique_ptr<CsvReader> m_pWindow;
+			size_t m_nRow = ~size_t(0);
+
+			std::vector<std::string> m_vecHeader;
+
+		};
 
 	public:
 		void SetFileName(std::string sFileName)
@@ -94,79 +939,523 @@ namespace sfl
 			m_sFileName = sFileName;
 		}
 
+		// Must be set before Load
+		void SetStorage(Storage storage)
+		{
+			m_storage = storage;
+		}
+
+		Storage GetStorage() const
+		{
+			return m_storage;
+		}
+
+		// Must be set before Load
+		void SetDialect(const CsvDialect& dialect)
+		{
+			m_dialect = dialect;
+		}
+
+		const CsvDialect& GetDialect() const
+		{
+			return m_dialect;
+		}
+
+		// Names from the first row if the dialect has a header
+		const std::vector<std::string>& GetHeader() const
+		{
+			return m_vecHeader;
+		}
+
+		// Types of columns for Storage::Columns, Type::Auto and columns after
+		// the end of the schema get their types from the values. Must be set before Load
+		void SetSchema(std::vector<Column::Type> vecTypes)
+		{
+			m_vecSchema = std::move(vecTypes);
+		}
+
+		// Same as SetSchema, but the column is found by its name in the header
+		void SetColumnType(const std::string& sName, Column::Type type)
+		{
+			m_vecNamedTypes.emplace_back(sName, type);
+		}
+
+		// Returns -1 if there is no such column
+		int GetColumnIndex(std::string_view sName) const
+		{
+			for (size_t i = 0; i < m_vecHeader.size(); i++)
+			{
+				if (m_vecHeader[i] == sName)
+					return (int)i;
+			}
+
+			return -1;
+		}
+
 		bool Load()
 		{
-			if (!m_ifCsvFile.is_open())
-				m_ifCsvFile.open(m_sFileName, std::ios::binary);
+			MappedFile file;
+
+			if (!file.Open(m_sFileName))
+				return false;
+
+			Clear();
+
+			if (m_storage == Storage::Rows)
+				m_sCells.reserve(file.Size());
+
+			Tokenize(file.Data(), file.Size());
+			EndLoad();
+
+			return true;
+		}
+
+		// Same as Load, but the file is cut into ranges of whole rows
+		// that are tokenized on the pool and then put together in order
+		bool LoadParallel(ThreadPool& pool = ThreadPool::Default())
+		{
+			if (pool.ThreadCount() < 2)
+				return Load();
 
-			if (!m_ifCsvFile.is_open())
+			MappedFile file;
+
+			if (!file.Open(m_sFileName))
 				return false;
 
-			for (int i = 0; !m_ifCsvFile.eof(); i++)
+			Clear();
+
+			std::vector<size_t> vecSplits = detail::CsvSplitRows(file.Data(), file.Size(), pool.ThreadCount() * 4,
+				m_dialect.cDelimiter, m_dialect.cQuote, m_dialect.cEscape, m_dialect.trim != CsvDialect::Trim::None, pool);
+			std::vector<CsvReader> vecParts(vecSplits.size() - 1);
+
+			pool.ParallelFor(0, vecParts.size(),
+				[&](size_t i)
+				{
+					vecParts[i].m_storage = m_storage;
+					vecParts[i].m_dialect = m_dialect;
+					vecParts[i].m_bInHeader = i == 0 && m_dialect.bHeader;
+
+					if (m_storage == Storage::Rows)
+						vecParts[i].m_sCells.reserve(vecSplits[i + 1] - vecSplits[i]);
+
+					vecParts[i].Tokenize(file.Data() + vecSplits[i], vecSplits[i + 1] - vecSplits[i]);
+				}, 1);
+
+			size_t nText = 0;
+
+			for (const auto& part : vecParts)
+				nText += part.m_sCells.size();
+
+			m_sCells.reserve(nText);
+
+			for (auto& part : vecParts)
+				Append(part);
+
+			if (!vecParts.empty())
+				m_vecHeader = std::move(vecParts[0].m_vecHeader);
+
+			EndLoad(&pool);
+
+			return true;
+		}
+
+		// Goes through rows of the file without loading it:
+		//   for (auto row : reader.Rows()) ...
+		RowStream Rows(size_t nBufferSize = 1 << 20) const
+		{
+			return RowStream(m_sFileName, m_dialect, nBufferSize);
+		}
+
+		// Only for Storage::Columns
+		const Column& GetColumn(int col) const
+		{
+			return m_vecColumns[col];
+		}
+
+		// Works in O(1) and returns an empty view if there is no such cell.
+		// Numbers in typed columns (Storage::Columns) have no text,
+		// so they are read with GetValue or GetColumn
+		std::string_view GetView(size_t row, size_t col) const
+		{
+			if (row >= m_nRows)
+				return {};
+
+			if (m_storage == Storage::Columns)
 			{
-				if (m_ifCsvFile.bad())
-					return false;
+				if (col >= m_vecColumns.size() || m_vecColumns[col].GetType() != Column::Type::String)
+					return {};
+
+				return m_vecColumns[col].View(row);
+			}
+
+			size_t nCell = m_vecRowOffsets[row] + col;
+
+			if (nCell >= m_vecRowOffsets[row + 1])
+				return {};
+
+			return std::string_view(m_sCells).substr(m_vecCellOffsets[nCell], m_vecCellOffsets[nCell + 1] - m_vecCellOffsets[nCell]);
+		}
+
+		std::string GetValue(int row, int col) const
+		{
+			if (row < 0 || col < 0)
+				return {};
+
+			if (m_storage == Storage::Columns && row < (int)m_nRows && col < (int)m_vecColumns.size())
+				return m_vecColumns[col].String(row);
+
+			return std::string(GetView(row, col));
+		}
+
+		// Number of cells in the row
+		size_t GetRowSize(size_t row) const
+		{
+			if (row >= m_nRows)
+				return 0;
+
+			if (m_storage == Storage::Columns)
+				return m_vecColumns.size();
+
+			return m_vecRowOffsets[row + 1] - m_vecRowOffsets[row];
+		}
+
+		RowView GetRow(size_t row) const
+		{
+			return RowView(this, row);
+		}
+
+		ColumnView GetColumnView(size_t col) const
+		{
+			return ColumnView(this, col);
+		}
+
+		void Print() const
+		{
+			for (size_t i = 0; i < m_nRows; i++)
+			{
+				std::cout << i + 1 << " ";
+
+				for (size_t j = 0; j < GetRowSize(i); j++)
+					std::cout << " " << GetValue((int)i, (int)j);
+
+				std::cout << "\n";
+			}
+		}
+
+		// The widest row decides
+		inline int GetTotalCols() const
+		{
+			return (int)m_nCols;
+		}
+
+		inline int GetTotalRows() const
+		{
+			return (int)m_nRows;
+		}
+
+	private:
+		static bool IsBlank(char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+
+		static std::string_view TrimBlanks(std::string_view s)
+		{
+			while (!s.empty() && IsBlank(s.front())) s.remove_prefix(1);
+			while (!s.empty() && IsBlank(s.back())) s.remove_suffix(1);
+
+			return s;
+		}
+
+		// Goes only through positions of the delimiter, new lines, quotes and
+		// escapes, so a value without quotes is just a view into the data.
+		// Quoted values are collected into the scratch buffer without quotes
+		void Tokenize(const char* pData, size_t nSize)
+		{
+			const CsvDialect& d = m_dialect;
+
+			const char cQuote = d.cQuote != 0 ? d.cQuote : d.cDelimiter;
+			const char cEscape = d.cQuote != 0 ? d.cEscape : d.cDelimiter;
+			const bool bQuotes = d.cQuote != 0;
+
+			detail::CsvScanner scanner(d.cDelimiter, '\n', cQuote, cEscape);
+
+			const char* pEnd = pData + nSize;
+			const char* pRow = pData;
+			const char* pField = pData;
+
+			// Positions before it were already handled as a part of an escape
+			const char* pSkip = pData;
+
+			bool bInQuotes = false;
+			bool bQuoted = false;
+
+			// Beginning of the text inside quotes that isn't in the scratch yet
+			const char* pPiece = nullptr;
+			std::string sScratch;
+
+			// Row ends at pFieldEnd, \r of \r\n isn't a part of the value
+			auto EmitField = [&](const char* pFieldEnd, bool bRowEnd)
+			{
+				if (bRowEnd && pFieldEnd > pField && pFieldEnd[-1] == '\r')
+					pFieldEnd--;
+
+				if (!bQuoted)
+				{
+					std::string_view sValue(pField, size_t(pFieldEnd - pField));
+
+					if (d.trim != CsvDialect::Trim::None)
+						sValue = TrimBlanks(sValue);
+
+					AddField(sValue);
+				}
+				else
+				{
+					// Text after the closing quote
+					if (pPiece < pFieldEnd)
+					{
+						std::string_view sRest(pPiece, size_t(pFieldEnd - pPiece));
+						sScratch += d.trim != CsvDialect::Trim::None ? TrimBlanks(sRest) : sRest;
+					}
 
-				std::string s;
-				std::vector<std::string> vecOut;
-				Cell c;
+					AddField(d.trim == CsvDialect::Trim::All ? TrimBlanks(sScratch) : std::string_view(sScratch));
+
+					sScratch.clear();
+					bQuoted = false;
+				}
+			};
 
-				std::getline(m_ifCsvFile, s);
-				Split(s, &vecOut);
+			for (size_t nBlock = 0; nBlock < nSize; nBlock += 64)
+			{
+				const char* pBlock = pData + nBlock;
+				uint64_t nMask = nSize - nBlock >= 64 ? scanner.Mask(pBlock) : scanner.Mask(pBlock, nSize - nBlock);
 
-				for (int j = 0; j < vecOut.size(); j++)
+				while (nMask != 0)
 				{
-					c.nCol = j;
-					c.nRow = i;
-					c.sValue = vecOut[j];
+					const char* p = pBlock + detail::CsvTrailingZeros(nMask);
+					nMask &= nMask - 1;
+
+					if (p < pSkip)
+						continue;
+
+					char c = *p;
+
+					if (bInQuotes)
+					{
+						if (c == cEscape && cEscape != cQuote)
+						{
+							// Next character goes as it is
+							sScratch.append(pPiece, p);
+							pPiece = p + 1;
+							pSkip = p + 2;
+						}
+						else if (c == cQuote)
+						{
+							sScratch.append(pPiece, p);
+
+							if (cEscape == cQuote && p + 1 < pEnd && p[1] == cQuote)
+							{
+								// Two quotes are one quote
+								pPiece = p + 1;
+								pSkip = p + 2;
+							}
+							else
+							{
+								bInQuotes = false;
+								pPiece = p + 1;
+							}
+						}
+
+						// Delimiters and new lines inside quotes are just text
+						continue;
+					}
+
+					if (c == d.cDelimiter)
+					{
+						EmitField(p, false);
+						pField = p + 1;
+					}
+					else if (c == '\n')
+					{
+						// Empty line is a row without values
+						bool bEmpty = pField == pRow && !bQuoted && (p == pRow || (p - pRow == 1 && *pRow == '\r'));
+
+						if (!bEmpty)
+							EmitField(p, true);
 
-					m_vecCells.push_back(c);
+						EndRow();
+						pField = pRow = p + 1;
+					}
+					else if (bQuotes && c == cQuote && !bQuoted)
+					{
+						// Quote opens a value only at its beginning,
+						// otherwise it's a part of the value
+						bool bStart = p == pField;
+
+						if (!bStart && d.trim != CsvDialect::Trim::None)
+							bStart = TrimBlanks(std::string_view(pField, size_t(p - pField))).empty();
+
+						if (bStart)
+						{
+							bInQuotes = true;
+							bQuoted = true;
+							pPiece = p + 1;
+						}
+					}
 				}
+			}
 
-				c.nCol++;
-				c.sValue = '\n';
+			// Last row without a new line
+			if (pRow < pEnd || bInQuotes)
+			{
+				if (bInQuotes)
+				{
+					// Quote wasn't closed, so the rest is the value
+					sScratch.append(pPiece, pEnd);
+					pPiece = pEnd;
+				}
 
-				m_vecCells.push_back(c);
+				EmitField(pEnd, true);
+				EndRow();
 			}
+		}
 
-			m_vecCells.pop_back();
-			m_vecCells.pop_back();
+		void Clear()
+		{
+			m_sCells.clear();
+			m_vecCellOffsets.assign(1, 0);
+			m_vecRowOffsets.assign(1, 0);
 
-			m_ifCsvFile.close();
+			m_vecColumns.clear();
 
-			return true;
+			m_nRows = 0;
+			m_nCols = 0;
+			m_nField = 0;
+
+			m_vecHeader.clear();
+			m_bInHeader = m_dialect.bHeader;
 		}
 
-		std::string GetValue(int row, int col)
+		void AddField(std::string_view sValue)
 		{
-			for (const auto cell : m_vecCells)
+			if (m_bInHeader)
+			{
+				m_vecHeader.emplace_back(sValue);
+				return;
+			}
+
+			if (m_storage == Storage::Columns)
+			{
+				// New column gets empty values for the rows before
+				if (m_nField == m_vecColumns.size())
+				{
+					m_vecColumns.emplace_back();
+					m_vecColumns.back().m_vecOffsets.resize(m_nRows + 1, 0);
+				}
+
+				m_vecColumns[m_nField].Append(sValue);
+			}
+			else
 			{
-				if (cell.nRow == row && cell.nCol == col)
-					return cell.sValue;
+				m_sCells += sValue;
+				m_vecCellOffsets.push_back(m_sCells.size());
 			}
+
+			m_nField++;
 		}
 
-		void Print()
+		void EndRow()
 		{
-			std::cout << "1 ";
+			if (m_bInHeader)
+			{
+				m_bInHeader = false;
+				return;
+			}
 
-			for (const auto cell : m_vecCells)
+			if (m_storage == Storage::Columns)
 			{
-				if (cell.sValue == "\n")
-					std::cout << "\n" << cell.nRow + 2 << " ";
-				else
-					std::cout << " " << cell.sValue;
+				for (size_t j = m_nField; j < m_vecColumns.size(); j++)
+					m_vecColumns[j].Append({});
 			}
+			else
+				m_vecRowOffsets.push_back(m_vecCellOffsets.size() - 1);
+
+			m_nCols = std::max(m_nCols, m_nField);
+			m_nField = 0;
+			m_nRows++;
 		}
 
-		inline int GetTotalCols()
+		// Adds rows of the other reader after own ones
+		void Append(const CsvReader& part)
 		{
-			return m_vecCells[m_vecCells.size() - 1].nCol + 1;
+			if (m_storage == Storage::Columns)
+			{
+				for (size_t j = 0; j < std::max(m_vecColumns.size(), part.m_vecColumns.size()); j++)
+				{
+					if (j == m_vecColumns.size())
+					{
+						m_vecColumns.emplace_back();
+						m_vecColumns.back().m_vecOffsets.resize(m_nRows + 1, 0);
+					}
+
+					Column& column = m_vecColumns[j];
+
+					if (j >= part.m_vecColumns.size())
+					{
+						column.m_vecOffsets.resize(column.m_vecOffsets.size() + part.m_nRows, column.m_sData.size());
+						continue;
+					}
+
+					const Column& other = part.m_vecColumns[j];
+					size_t nBase = column.m_sData.size();
+
+					column.m_sData += other.m_sData;
+
+					for (size_t i = 1; i < other.m_vecOffsets.size(); i++)
+						column.m_vecOffsets.push_back(nBase + other.m_vecOffsets[i]);
+				}
+			}
+			else
+			{
+				size_t nTextBase = m_sCells.size();
+				size_t nCellBase = m_vecCellOffsets.size() - 1;
+
+				m_sCells += part.m_sCells;
+
+				for (size_t i = 1; i < part.m_vecCellOffsets.size(); i++)
+					m_vecCellOffsets.push_back(nTextBase + part.m_vecCellOffsets[i]);
+
+				for (size_t i = 1; i < part.m_vecRowOffsets.size(); i++)
+					m_vecRowOffsets.push_back(nCellBase + part.m_vecRowOffsets[i]);
+			}
+
+			m_nRows += part.m_nRows;
+			m_nCols = std::max(m_nCols, part.m_nCols);
 		}
 
-		inline int GetTotalRows()
+		// Parses typed columns, each one on its own thread if there is a pool
+		void EndLoad(ThreadPool* pPool = nullptr)
 		{
-			return m_vecCells[m_vecCells.size() - 1].nRow + 1;
+			std::vector<Column::Type> vecTypes = m_vecSchema;
+			vecTypes.resize(m_vecColumns.size(), Column::Type::Auto);
+
+			for (const auto& [sName, type] : m_vecNamedTypes)
+			{
+				int col = GetColumnIndex(sName);
+
+				if (col >= 0 && col < (int)vecTypes.size())
+					vecTypes[col] = type;
+			}
+
+			auto Parse = [&](size_t j) { m_vecColumns[j].SetType(vecTypes[j]); };
+
+			if (pPool && m_vecColumns.size() > 1)
+				pPool->ParallelFor(0, m_vecColumns.size(), Parse, 1);
+			else
+			{
+				for (size_t j = 0; j < m_vecColumns.size(); j++)
+					Parse(j);
+			}
 		}
 
 	};
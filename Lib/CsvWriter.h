@@ -0,0 +1,423 @@
+#pragma once
+
+#pragma region license
+/***
+*	BSD 3-Clause License
+	Copyright (c) 2021, 2022 Alex
+	All rights reserved.
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***/
+#pragma endregion
+
+#pragma region includes
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "CsvReader.h"
+
+#pragma endregion
+
+namespace sfl
+{
+	namespace detail
+	{
+		template <typename T>
+		constexpr bool CsvIsWideChar = std::is_same_v<T, wchar_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+	}
+
+	// Puts rows into a big buffer that goes to the file in one write when
+	// it's full. Numbers are formatted with to_chars and values are quoted
+	// only when they have to be. With a background thread the full buffer
+	// is written there while the next one is being filled
+	class CsvWriter
+	{
+	public:
+		CsvWriter() = default;
+
+		CsvWriter(const std::string& sFileName, bool bBackground = false)
+		{
+			Open(sFileName, bBackground);
+		}
+
+		~CsvWriter()
+		{
+			Close();
+		}
+
+		CsvWriter(const CsvWriter&) = delete;
+		CsvWriter& operator=(const CsvWriter&) = delete;
+
+	public:
+		// Must be set before Open
+		void SetDialect(const CsvDialect& dialect)
+		{
+			m_dialect = dialect;
+		}
+
+		const CsvDialect& GetDialect() const
+		{
+			return m_dialect;
+		}
+
+		// Amount of bytes that are collected before a write, must be set before Open
+		void SetBufferSize(size_t nSize)
+		{
+			m_nBufferSize = std::max<size_t>(nSize, 64);
+		}
+
+		// Rows end with "\r\n" instead of "\n"
+		void SetCRLF(bool bCRLF)
+		{
+			m_bCRLF = bCRLF;
+		}
+
+		bool Open(const std::string& sFileName, bool bBackground = false)
+		{
+			Close();
+
+			m_file.open(sFileName, std::ios::binary);
+
+			if (!m_file.is_open())
+				return false;
+
+			m_bFailed = false;
+			m_bRowStart = true;
+
+			m_vecBuffer.resize(m_nBufferSize);
+			m_nUsed = 0;
+
+			// Characters that make a value go in quotes
+			std::memset(m_aSpecial, 0, sizeof(m_aSpecial));
+
+			for (char c : { m_dialect.cDelimiter, '\n', '\r' })
+				m_aSpecial[(unsigned char)c] = true;
+
+			if (m_dialect.cQuote != 0)
+			{
+				m_aSpecial[(unsigned char)m_dialect.cQuote] = true;
+				m_aSpecial[(unsigned char)m_dialect.cEscape] = true;
+			}
+
+			if (bBackground)
+			{
+				m_bStop = false;
+				m_thread = std::thread(&CsvWriter::BackgroundWrite, this);
+			}
+
+			return true;
+		}
+
+		bool IsOpen() const
+		{
+			return m_file.is_open();
+		}
+
+		// Writes everything that is left and closes the file,
+		// returns false if any write has failed
+		bool Close()
+		{
+			if (!m_file.is_open())
+				return false;
+
+			if (!m_bRowStart)
+				EndRow();
+
+			Flush();
+
+			if (m_thread.joinable())
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_bStop = true;
+				}
+
+				m_cvPending.notify_one();
+				m_thread.join();
+			}
+
+			m_file.close();
+			return !m_bFailed;
+		}
+
+		// Sends the buffer to the file (or to the background thread)
+		bool Flush()
+		{
+			if (m_nUsed > 0)
+			{
+				if (m_thread.joinable())
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_cvDone.wait(lock, [this] { return m_nPending == 0; });
+
+					// Now the thread has nothing to write, so it's safe to swap
+					m_vecBuffer.swap(m_vecPending);
+					m_nPending = m_nUsed;
+
+					if (m_vecBuffer.size() < m_nBufferSize)
+						m_vecBuffer.resize(m_nBufferSize);
+
+					m_cvPending.notify_one();
+				}
+				else
+				{
+					m_file.write(m_vecBuffer.data(), m_nUsed);
+
+					if (!m_file)
+						m_bFailed = true;
+				}
+
+				m_nUsed = 0;
+			}
+
+			return !m_bFailed;
+		}
+
+		// Without quotes (cQuote == 0) a value with the delimiter or a new line
+		// can't be written, then it's left empty and Flush and Close return false
+		CsvWriter& Write(std::string_view sValue)
+		{
+			// Row with only an empty value would be read as a row without values
+			bool bQuote = sValue.empty() && m_bRowStart;
+
+			// Blanks around a value are kept by a reader only inside quotes
+			if (!sValue.empty() && (IsBlank(sValue.front()) || IsBlank(sValue.back())))
+				bQuote = true;
+
+			BeginValue();
+
+			bool bSpecial = false;
+
+			for (char c : sValue)
+			{
+				if (m_aSpecial[(unsigned char)c])
+				{
+					bSpecial = true;
+					break;
+				}
+			}
+
+			if (m_dialect.cQuote == 0)
+			{
+				if (bSpecial)
+				{
+					m_bFailed = true;
+					return *this;
+				}
+
+				bQuote = false;
+			}
+
+			if (!bQuote && !bSpecial)
+			{
+				char* p = Reserve(sValue.size());
+				std::memcpy(p, sValue.data(), sValue.size());
+				m_nUsed += sValue.size();
+
+				return *this;
+			}
+
+			// In the worst case every character is escaped
+			char* pBegin = Reserve(sValue.size() * 2 + 2);
+			char* p = pBegin;
+
+			const char cQuote = m_dialect.cQuote;
+			const char cEscape = m_dialect.cEscape;
+
+			*p++ = cQuote;
+
+			for (char c : sValue)
+			{
+				if (c == cQuote || (c == cEscape && cEscape != cQuote))
+					*p++ = cEscape;
+
+				*p++ = c;
+			}
+
+			*p++ = cQuote;
+
+			m_nUsed += size_t(p - pBegin);
+			return *this;
+		}
+
+		CsvWriter& Write(const char* sValue)
+		{
+			return Write(std::string_view(sValue));
+		}
+
+		CsvWriter& Write(const std::string& sValue)
+		{
+			return Write(std::string_view(sValue));
+		}
+
+		// char is written as a character, signed and unsigned char (int8_t and uint8_t)
+		// as numbers, other character types aren't accepted
+		template <typename T>
+		std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !detail::CsvIsWideChar<T>, CsvWriter&> Write(T value)
+		{
+			if constexpr (std::is_same_v<T, char>)
+				return Write(std::string_view(&value, 1));
+			else
+			{
+				BeginValue();
+
+				// Enough for any number in the shortest form
+				char* p = Reserve(64);
+				m_nUsed += size_t(std::to_chars(p, p + 64, value).ptr - p);
+
+				return *this;
+			}
+		}
+
+		// Empty value, it's read back as a null. Same as an empty text,
+		// so alone in a row it's quoted and isn't read as an empty line
+		CsvWriter& WriteNull()
+		{
+			return Write("");
+		}
+
+		CsvWriter& EndRow()
+		{
+			char* p = Reserve(2);
+
+			if (m_bCRLF)
+				*p++ = '\r';
+
+			*p = '\n';
+
+			m_nUsed += m_bCRLF ? 2 : 1;
+			m_bRowStart = true;
+
+			return *this;
+		}
+
+		// writer.WriteRow("name", 42, 3.5);
+		template <typename... Args>
+		CsvWriter& WriteRow(const Args&... args)
+		{
+			(Write(args), ...);
+			return EndRow();
+		}
+
+		// Any range of values, like std::vector<std::string> or CsvReader::RowView
+		template <typename Range>
+		CsvWriter& WriteRange(const Range& range)
+		{
+			for (const auto& value : range)
+				Write(value);
+
+			return EndRow();
+		}
+
+	private:
+		static bool IsBlank(char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+
+		void BeginValue()
+		{
+			if (!m_bRowStart)
+			{
+				*Reserve(1) = m_dialect.cDelimiter;
+				m_nUsed++;
+			}
+
+			m_bRowStart = false;
+		}
+
+		// Returns place for nSize bytes at the end of the buffer
+		char* Reserve(size_t nSize)
+		{
+			if (m_nUsed + nSize > m_vecBuffer.size())
+			{
+				Flush();
+
+				// Value is bigger than the whole buffer
+				if (nSize > m_vecBuffer.size())
+					m_vecBuffer.resize(nSize);
+			}
+
+			return m_vecBuffer.data() + m_nUsed;
+		}
+
+		void BackgroundWrite()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (true)
+			{
+				m_cvPending.wait(lock, [this] { return m_nPending > 0 || m_bStop; });
+
+				if (m_nPending == 0)
+					return;
+
+				// The buffer belongs to this thread until m_nPending is 0 again
+				lock.unlock();
+
+				m_file.write(m_vecPending.data(), m_nPending);
+
+				if (!m_file)
+					m_bFailed = true;
+
+				lock.lock();
+
+				m_nPending = 0;
+				m_cvDone.notify_one();
+			}
+		}
+
+	private:
+		CsvDialect m_dialect;
+		bool m_bCRLF = false;
+
+		std::ofstream m_file;
+		std::atomic<bool> m_bFailed = false;
+
+		std::vector<char> m_vecBuffer;
+		size_t m_nUsed = 0;
+		size_t m_nBufferSize = 1 << 20;
+
+		bool m_bRowStart = true;
+		bool m_aSpecial[256]{};
+
+		// Background writing
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_cvPending;
+		std::condition_variable m_cvDone;
+
+		std::vector<char> m_vecPending;
+		size_t m_nPending = 0;
+		bool m_bStop = false;
+
+	};
+}
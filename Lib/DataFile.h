@@ -33,61 +33,473 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cctype>
 #include <unordered_map>
 #include <functional>
 #include <fstream>
 #include <list>
 #include <stack>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <charconv>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
 
 #pragma endregion
 
 namespace sfl
 {
+	namespace detail
+	{
+		inline std::string_view TrimView(std::string_view s)
+		{
+			size_t nBegin = s.find_first_not_of(" \t\n\r\f\v");
+
+			if (nBegin == std::string_view::npos)
+				return {};
+
+			size_t nEnd = s.find_last_not_of(" \t\n\r\f\v");
+			return s.substr(nBegin, nEnd - nBegin + 1);
+		}
+
+		// Parser state that lives between lines: name of the last field
+		// (or object) and a buffer for values that had quotes inside
+		struct DataParseState
+		{
+			std::string_view sName;
+			std::string sScratch;
+		};
+
+		// That's the grammar of the text format, one line at a time:
+		//   name = value; value2      calls OnField(name, value) for every value
+		//   name                      remembers name for the next object
+		//   {                         calls OnBegin(name)
+		//   }                         calls OnEnd()
+		// Views passed to the handler point into the line or into
+		// the scratch buffer, so they must be copied to be kept
+		template <typename Handler>
+		void ParseDataLine(std::string_view sLine, DataParseState& state, Handler& handler)
+		{
+			sLine = TrimView(sLine);
+
+			if (sLine.empty())
+				return;
+
+			// Find fields
+			size_t i = sLine.find('=');
+			if (i != std::string_view::npos)
+			{
+				state.sName = TrimView(sLine.substr(0, i));
+
+				std::string_view sFieldValue = TrimView(sLine.substr(i + 1));
+
+				if (sFieldValue.find('\"') == std::string_view::npos)
+				{
+					// No quotes, so every value is just a slice of the line
+					while (true)
+					{
+						size_t nSemicolon = sFieldValue.find(';');
+
+						if (nSemicolon == std::string_view::npos)
+						{
+							if (!sFieldValue.empty())
+								handler.OnField(state.sName, TrimView(sFieldValue));
+
+							break;
+						}
+
+						handler.OnField(state.sName, TrimView(sFieldValue.substr(0, nSemicolon)));
+						sFieldValue.remove_prefix(nSemicolon + 1);
+					}
+				}
+				else
+				{
+					bool bQuotes = false;
+					std::string& sToken = state.sScratch;
+					sToken.clear();
+
+					for (const auto& c : sFieldValue)
+					{
+						if (c == '\"')
+						{
+							// start or end of the string
+							bQuotes = !bQuotes;
+						}
+						else
+						{
+							if (bQuotes)
+							{
+								sToken += c;
+							}
+							else
+							{
+								if (c == ';')
+								{
+									// Add value to the vector of values
+									handler.OnField(state.sName, TrimView(sToken));
+
+									// Reset token
+									sToken.clear();
+								}
+								else
+								{
+									// if it's not a delimiter, so just add it
+									sToken += c;
+								}
+							}
+						}
+					}
+
+					if (!sToken.empty())
+						handler.OnField(state.sName, TrimView(sToken));
+				}
+			}
+			else // It's not a field
+			{
+				// then it could be an object
+				if (sLine.front() == '{')
+				{
+					handler.OnBegin(state.sName);
+				}
+				else
+				{
+					if (sLine.back() == '}')
+					{
+						// Object was already defined
+						handler.OnEnd();
+					}
+					else
+					{
+						state.sName = sLine;
+					}
+				}
+			}
+		}
+
+		// Splits the buffer into lines and feeds them to the grammar,
+		// views given to the handler point straight into the buffer
+		// unless a value had quotes
+		template <typename Handler>
+		void ParseDataBuffer(const char* pData, size_t nSize, DataParseState& state, Handler& handler)
+		{
+			const char* pEnd = pData + nSize;
+
+			while (pData < pEnd)
+			{
+				const char* pNewLine = (const char*)memchr(pData, '\n', size_t(pEnd - pData));
+
+				if (!pNewLine)
+					pNewLine = pEnd;
+
+				ParseDataLine(std::string_view(pData, size_t(pNewLine - pData)), state, handler);
+				pData = pNewLine + 1;
+			}
+		}
+
+		// Offsets where the buffer can be cut into about nParts pieces that
+		// parse the same way on their own. Cuts are made only at the top level
+		// and before a field or a name line, since those set the name
+		// themselves, and lines are classified the same way as in ParseDataLine
+		inline std::vector<size_t> SplitDataBuffer(const char* pData, size_t nSize, size_t nParts)
+		{
+			std::vector<size_t> vecSplits{ 0 };
+
+			size_t nTarget = std::max<size_t>(1, nSize / std::max<size_t>(1, nParts));
+			size_t nNext = nTarget;
+			size_t nDepth = 0;
+
+			const char* pLine = pData;
+			const char* pEnd = pData + nSize;
+
+			while (pLine < pEnd)
+			{
+				const char* pNewLine = (const char*)memchr(pLine, '\n', size_t(pEnd - pLine));
+
+				if (!pNewLine)
+					pNewLine = pEnd;
+
+				std::string_view sLine = TrimView(std::string_view(pLine, size_t(pNewLine - pLine)));
+				size_t nOffset = size_t(pLine - pData);
+
+				if (!sLine.empty())
+				{
+					bool bNamed = false;
+
+					if (sLine.find('=') != std::string_view::npos)
+						bNamed = true;
+					else if (sLine.front() == '{')
+						nDepth++;
+					else if (sLine.back() == '}')
+						nDepth -= nDepth > 0 ? 1 : 0;
+					else
+						bNamed = true;
+
+					if (bNamed && nDepth == 0 && nOffset >= nNext)
+					{
+						vecSplits.push_back(nOffset);
+						nNext = nOffset + nTarget;
+					}
+				}
+
+				pLine = pNewLine + 1;
+			}
+
+			vecSplits.push_back(nSize);
+			return vecSplits;
+		}
+
+		// Same text as std::to_string gives, but without going through printf
+		inline std::string FormatInt(long long nValue)
+		{
+			char buf[24];
+			auto [p, ec] = std::to_chars(buf, buf + sizeof(buf), nValue);
+			return std::string(buf, p);
+		}
+
+		inline std::string FormatDecimal(long double dValue)
+		{
+			char buf[64];
+			auto [p, ec] = std::to_chars(buf, buf + sizeof(buf), dValue, std::chars_format::fixed, 6);
+
+			// Too big to fit into the buffer
+			if (ec != std::errc())
+				return std::to_string(dValue);
+
+			return std::string(buf, p);
+		}
+
+		// Casting NaN or a decimal out of the long long range is undefined
+		inline bool FitsInt(long double dValue)
+		{
+			return dValue >= -9223372036854775808.0L && dValue < 9223372036854775808.0L;
+		}
+
+		// Anything from_chars doesn't take completely (spaces, '+',
+		// trailing text, overflow) goes to stoll/stold, so results
+		// and exceptions stay the same as they were
+		inline long long ParseInt(std::string_view s)
+		{
+			long long nValue = 0;
+			auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), nValue);
+
+			if (ec != std::errc() || p != s.data() + s.size())
+				return std::stoll(std::string(s));
+
+			return nValue;
+		}
+
+		inline long double ParseDecimal(std::string_view s)
+		{
+			long double dValue = 0.0;
+			auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), dValue);
+
+			if (ec != std::errc() || p != s.data() + s.size())
+				return std::stold(std::string(s));
+
+			return dValue;
+		}
+
+		// Binary format, every number is little-endian and unaligned:
+		//   header  "SFLDFB02"
+		//   node    uint8 type, then
+		//           object:  uint32 count, uint64 offset[count], uint32 sorted[count], entries
+		//           string:  uint32 length, bytes
+		//           int:     int64
+		//           decimal: double
+		//           bool:    uint8
+		//   entry   uint32 key length, key bytes, node
+		// Offsets are from the start of the file and point to entries,
+		// so a child can be found without walking the ones before it.
+		// Sorted has indices of entries in the order of their keys for a binary search.
+		// Entries go one right after another, so every node has its own bytes
+		constexpr char DataBinaryMagic[8] = { 'S', 'F', 'L', 'D', 'F', 'B', '0', '2' };
+
+		enum class DataBinaryType : uint8_t
+		{
+			Object,
+			String,
+			Int,
+			Decimal,
+			Bool
+		};
+
+		inline bool IsLittleEndian()
+		{
+			const uint16_t n = 1;
+			return *(const uint8_t*)&n == 1;
+		}
+
+		// Bytes of the value in the file order
+		template <typename T>
+		void StoreBinary(char* pDest, const T& value)
+		{
+			memcpy(pDest, &value, sizeof(T));
+
+			if (!IsLittleEndian())
+				std::reverse(pDest, pDest + sizeof(T));
+		}
+
+		template <typename T>
+		void AppendBinary(std::string& sOut, const T& value)
+		{
+			char buf[sizeof(T)];
+			StoreBinary(buf, value);
+			sOut.append(buf, sizeof(T));
+		}
+
+		template <typename T>
+		bool ReadBinaryValue(const char* pData, size_t nSize, size_t nOffset, T& value)
+		{
+			if (nOffset > nSize || nSize - nOffset < sizeof(T))
+				return false;
+
+			char buf[sizeof(T)];
+			memcpy(buf, pData + nOffset, sizeof(T));
+
+			if (!IsLittleEndian())
+				std::reverse(buf, buf + sizeof(T));
+
+			memcpy(&value, buf, sizeof(T));
+			return true;
+		}
+
+		// A value is stored as a number only if it's exactly what SetInt or
+		// SetDecimal would produce, so String() gives the same text back
+		inline DataBinaryType DetectBinaryType(const std::string& s, long long& nValue, double& dValue)
+		{
+			if (s.empty())
+				return DataBinaryType::String;
+
+			const char* pEnd = s.data() + s.size();
+
+			auto [pInt, ecInt] = std::from_chars(s.data(), pEnd, nValue);
+			if (ecInt == std::errc() && pInt == pEnd && FormatInt(nValue) == s)
+				return DataBinaryType::Int;
+
+			auto [pDec, ecDec] = std::from_chars(s.data(), pEnd, dValue);
+			if (ecDec == std::errc() && pDec == pEnd && FormatDecimal(dValue) == s)
+				return DataBinaryType::Decimal;
+
+			return DataBinaryType::String;
+		}
+	}
+
 	class DataFile
 	{
 	public:
 		DataFile() = default;
 		~DataFile() = default;
 
+		// Declared destructor would make moves fall back to copies,
+		// so growing vecObjects would copy whole subtrees
+		DataFile(const DataFile&) = default;
+		DataFile(DataFile&&) = default;
+
+		DataFile& operator=(const DataFile&) = default;
+		DataFile& operator=(DataFile&&) = default;
+
+	public:
+		// Which type the value was set as, the other representations
+		// are made by the setter, so const access never writes anything
+		// and a tree can be read from many threads
+		enum class Type : uint8_t
+		{
+			String,
+			Int,
+			Decimal,
+			Bool
+		};
+
 	public:
 		void SetString(const std::string& v)
 		{
-			sValue = v;
+			m_sValue = v;
+			SetType(Type::String, CachedString);
+			CacheNumbers();
+		}
+
+		void SetString(std::string&& v)
+		{
+			m_sValue = std::move(v);
+			SetType(Type::String, CachedString);
+			CacheNumbers();
 		}
 
-		const std::string String() const
+		const std::string& String() const
 		{
-			return sValue;
+			return m_sValue;
 		}
 
 		void SetInt(long long nValue)
 		{
-			SetString(std::to_string(nValue));
+			m_nValue = nValue;
+			m_dValue = (long double)nValue;
+			m_sValue = detail::FormatInt(nValue);
+			SetType(Type::Int, CachedString | CachedInt | CachedDecimal);
 		}
 
+		// Text that isn't a whole number is parsed on every call,
+		// so is a decimal that doesn't fit and stoll throws for it
 		long long Int() const
 		{
-			return std::stoll(String());
+			if (m_nCached & CachedInt)
+				return m_nValue;
+
+			return detail::ParseInt(m_sValue);
 		}
 
 		void SetDecimal(long double dValue)
 		{
-			SetString(std::to_string(dValue));
+			m_dValue = dValue;
+			m_sValue = detail::FormatDecimal(dValue);
+
+			if (detail::FitsInt(dValue))
+			{
+				m_nValue = (long long)dValue;
+				SetType(Type::Decimal, CachedString | CachedInt | CachedDecimal);
+			}
+			else
+				SetType(Type::Decimal, CachedString | CachedDecimal);
 		}
 
 		long double Decimal() const
 		{
-			return std::stold(String());
+			if (m_nCached & CachedDecimal)
+				return m_dValue;
+
+			return detail::ParseDecimal(m_sValue);
 		}
 
 		void SetBool(const bool bValue)
 		{
-			SetString(std::to_string((int)bValue));
+			// Bool lives in the integer slot
+			m_nValue = bValue;
+			m_dValue = bValue ? 1.0L : 0.0L;
+			m_sValue = bValue ? "1" : "0";
+			SetType(Type::Bool, CachedString | CachedInt | CachedDecimal);
 		}
 
 		bool Bool() const
 		{
-			return (bool)std::stoll(String());
+			return Int() != 0;
+		}
+
+		Type GetType() const
+		{
+			return m_type;
+		}
+
+		// For changes made through vecObjects or mapObjects,
+		// so a CachedWriter formats the object again
+		void MarkDirty()
+		{
+			m_bDirty = true;
 		}
 
 		bool HasProperty(const std::string& name) const
@@ -97,101 +509,152 @@ namespace sfl
 			return mapObjects.count(name) > 0;
 		}
 
-		DataFile& operator[](const std::string& key)
+		// Unlike operator[] it never inserts and returns nullptr if there is no such object
+		DataFile* Find(const std::string& key)
 		{
-			// Check if object with that name already exists
-			// for C++20 we can use    m_mapObjects.contains(key)
-			if (mapObjects.count(key) == 0)
-			{
-				// No, so create it
-
-				// firstly set index to be accessed
-				// by the name of the object
-				mapObjects[key] = vecObjects.size();
+			auto it = mapObjects.find(key);
+			return it == mapObjects.end() ? nullptr : &vecObjects[it->second].second;
+		}
 
-				// then create empty object
-				vecObjects.push_back({ key, DataFile() });
-			}
+		const DataFile* Find(const std::string& key) const
+		{
+			auto it = mapObjects.find(key);
+			return it == mapObjects.end() ? nullptr : &vecObjects[it->second].second;
+		}
 
-			// If that exists then just return that object
-			return vecObjects[mapObjects[key]].second;
+		DataFile& operator[](const std::string& key)
+		{
+			return vecObjects[ChildIndex(key)].second;
 		}
 
 		DataFile& operator[](size_t index)
 		{
-			std::string i = std::to_string(index);
+			return vecObjects[ChildIndex(std::to_string(index))].second;
+		}
 
-			// Check if object with that name already exists
-			// for C++20 we can use    m_mapObjects.contains(key)
-			if (mapObjects.count(i) == 0)
+		// Keys split once, e.g. Path("Info/Stats/Level"). Indices of the found
+		// objects are remembered, so next lookups only check that the key
+		// at that index is still the same instead of hashing it
+		class Path
+		{
+		public:
+			Path(const std::string& sPath, char cSeparator = '/')
 			{
-				// No, so create it
+				size_t nBegin = 0;
+
+				while (nBegin <= sPath.size())
+				{
+					size_t nEnd = sPath.find(cSeparator, nBegin);
 
-				// firstly set index to be accessed
-				// by the name of the object
-				mapObjects[i] = vecObjects.size();
+					if (nEnd == std::string::npos)
+						nEnd = sPath.size();
 
-				// then create empty object
-				vecObjects.push_back({ i, DataFile() });
-			}
+					if (nEnd > nBegin)
+						m_vecKeys.push_back(sPath.substr(nBegin, nEnd - nBegin));
 
-			// If that exists then just return that object
-			return vecObjects[mapObjects[i]].second;
-		}
+					nBegin = nEnd + 1;
+				}
 
-		static bool Write(DataFile& dfDataFile, const std::string& sFileName)
-		{
-			std::function<void(std::ofstream&, DataFile&, size_t)> Write = [&](std::ofstream& os, DataFile& df, size_t tabs)
+				m_vecIndices.resize(m_vecKeys.size(), npos);
+			}
+
+			const std::vector<std::string>& Keys() const
 			{
-				auto AddTabs = [&]()
-				{
-					for (size_t i = 0; i < tabs; i++)
-						os << '\t';
-				};
+				return m_vecKeys;
+			}
 
-				// name, index
-				for (auto& obj : df.vecObjects)
-				{
-					AddTabs();
+		private:
+			friend class DataFile;
 
-					// Check if there are no other objects
-					if (obj.second.vecObjects.empty())
-					{
-						// if it is, we should extract field name and value
-						std::string& sName = obj.first;
-						std::string& sValue = obj.second.sValue;
+			static constexpr size_t npos = ~size_t(0);
 
-						// insert name and value
-						os << sName << " = " << sValue << ";\n";
-					}
-					else
+			template <typename Node>
+			Node* Walk(Node* pNode, bool bInsert) const
+			{
+				for (size_t i = 0; i < m_vecKeys.size(); i++)
+				{
+					size_t& nIndex = m_vecIndices[i];
+					const std::string& sKey = m_vecKeys[i];
+
+					if (nIndex >= pNode->vecObjects.size() || pNode->vecObjects[nIndex].first != sKey)
 					{
-						std::string& sName = obj.first;
-						DataFile& dfChild = obj.second;
+						bool bFound = false;
 
-						os << sName << "\n";
+						if constexpr (!std::is_const_v<Node>)
+						{
+							if (bInsert)
+							{
+								nIndex = pNode->ChildIndex(sKey);
+								bFound = true;
+							}
+						}
 
-						AddTabs();
-						os << "(\n";
+						if (!bFound)
+						{
+							auto it = pNode->mapObjects.find(sKey);
 
-						// there are some objects, so parse them too
-						Write(os, dfChild, tabs + 1);
+							if (it == pNode->mapObjects.end())
+								return nullptr;
 
-						AddTabs();
-						os << ')' << std::endl;
+							nIndex = it->second;
+						}
 					}
+
+					pNode = &pNode->vecObjects[nIndex].second;
 				}
-			};
 
+				return pNode;
+			}
+
+		private:
+			std::vector<std::string> m_vecKeys;
+
+			// Cached per key, so const access isn't thread-safe
+			mutable std::vector<size_t> m_vecIndices;
+
+		};
+
+		DataFile* Find(const Path& path)
+		{
+			return path.Walk(this, false);
+		}
+
+		const DataFile* Find(const Path& path) const
+		{
+			return path.Walk(this, false);
+		}
+
+		// Creates all missing objects on the way
+		DataFile& operator[](const Path& path)
+		{
+			return *path.Walk(this, true);
+		}
+
+		static bool Write(const DataFile& dfDataFile, const std::string& sFileName)
+		{
 			std::ofstream file(sFileName);
 
 			// If file was opened without problems,
 			// we just write into it
 			if (file.is_open())
 			{
-				Write(file, dfDataFile, 0);
+				std::string sOut;
+				sOut.reserve(nWriteBlockSize);
+
+				for (const auto& [sName, dfChild] : dfDataFile.vecObjects)
+				{
+					AppendText(sOut, sName, dfChild, 0);
+
+					// The text goes to the file in big pieces
+					if (sOut.size() >= nWriteBlockSize)
+					{
+						file.write(sOut.data(), sOut.size());
+						sOut.clear();
+					}
+				}
 
-				file.close();
+				file.write(sOut.data(), sOut.size());
+				return file.good();
 			}
 
 			// ... else error was occured,
@@ -199,130 +662,611 @@ namespace sfl
 			return false;
 		}
 
-		static bool Read(DataFile& dfDataFile, const std::string& sFileName)
+		// Keeps the text of every top level object from the last save and
+		// skips formatting of the objects that are still clean. It's only
+		// a dirty check: every save walks the whole tree to look at the flags
+		// and writes the whole file again. Flags are set by the setters,
+		// operator[] and merges, so code that changes vecObjects or mapObjects
+		// directly must call MarkDirty() on the changed object (or Reset()
+		// the writer), otherwise the old text is written.
+		// A tree should be saved by one writer
+		class CachedWriter
 		{
-			auto Trim = [](std::string& s)
-			{
-				s.erase(0, s.find_first_not_of(" \t\n\r\f\v"));
-				s.erase(s.find_last_not_of(" \t\n\r\f\v") + 1);
-			};
-
-			std::ifstream fFile(sFileName);
-
-			// If file was opened without problems,
-			// we just read from it
-			if (fFile.is_open())
+		public:
+			bool Save(DataFile& dfDataFile, const std::string& sFileName)
 			{
-				std::string sFieldName = "";
-				std::string sFieldValue = "";
-
-				std::stack<std::reference_wrapper<DataFile>> stack;
-				stack.push(dfDataFile);
+				m_vecBlocks.resize(dfDataFile.vecObjects.size());
 
-				while (!fFile.eof())
+				for (size_t i = 0; i < m_vecBlocks.size(); i++)
 				{
-					// Get line from the file
-					std::string sLine;
-					std::getline(fFile, sLine);
+					auto& [sName, dfChild] = dfDataFile.vecObjects[i];
+					Block& block = m_vecBlocks[i];
 
-					if (!sLine.empty())
-						Trim(sLine);
-
-					if (!sLine.empty())
+					if (block.sText.empty() || block.sName != sName || IsDirty(dfChild))
 					{
-						// Find fields
-						size_t i = sLine.find_first_of('=');
-						if (i != std::string::npos)
-						{
-							sFieldName = sLine.substr(0, i);
-							Trim(sFieldName);
+						block.sName = sName;
+						block.sText.clear();
+
+						AppendText(block.sText, sName, dfChild, 0);
+						ClearDirty(dfChild);
+					}
+				}
 
-							sFieldValue = sLine.substr(i + 1, sLine.length());
-							Trim(sFieldValue);
+				dfDataFile.m_bDirty = false;
 
-							bool bQuotes = false;
-							std::string sToken;
+				std::ofstream file(sFileName);
 
-							for (const auto& c : sFieldValue)
-							{
-								if (c == '\"')
-								{
-									// start or end of the string
-									bQuotes = !bQuotes;
-								}
-								else
-								{
-									if (bQuotes)
-									{
-										sToken += c;
-									}
-									else
-									{
-										if (c == ';')
-										{
-											Trim(sToken);
-
-											// Add value to the vector of values
-											stack.top().get()[sFieldName].SetString(sToken);
-
-											// Reset token
-											sToken.clear();
-										}
-										else
-										{
-											// if it's not a delimiter, so just add it
-											sToken += c;
-										}
-									}
-								}
-							}
+				if (!file.is_open())
+					return false;
 
-							if (!sToken.empty())
-							{
-								Trim(sToken);
-								stack.top().get()[sFieldName].SetString(sToken);
-							}
-						}
-						else // It's not a field
-						{
-							// then it could be an object
-							if (sLine.front() == '{')
-							{
-								// Push it as an object to the stack
-								stack.push(stack.top().get()[sFieldName]);
-							}
-							else
-							{
-								if (sLine.back() == '}')
-								{
-									// Object was already defined,
-									// so remove it from the stack
-									stack.pop();
-								}
-								else
-								{
-									sFieldName = sLine;
-								}
-							}
-						}
+				std::string sOut;
+				sOut.reserve(nWriteBlockSize);
 
+				for (const auto& block : m_vecBlocks)
+				{
+					if (sOut.size() + block.sText.size() > nWriteBlockSize)
+					{
+						file.write(sOut.data(), sOut.size());
+						sOut.clear();
 					}
+
+					// Don't copy what would fill the buffer by itself
+					if (block.sText.size() >= nWriteBlockSize)
+						file.write(block.sText.data(), block.sText.size());
+					else
+						sOut += block.sText;
 				}
 
+				file.write(sOut.data(), sOut.size());
+				return file.good();
+			}
 
-				fFile.close();
-				return true;
+			// Next save formats everything again
+			void Reset()
+			{
+				m_vecBlocks.clear();
+			}
+
+		private:
+			struct Block
+			{
+				std::string sName;
+				std::string sText;
+			};
+
+			std::vector<Block> m_vecBlocks;
+
+		};
+
+		static bool Read(DataFile& dfDataFile, const std::string& sFileName)
+		{
+			// The whole file is mapped, so lines and values are
+			// only views into it until they're stored in the tree
+			MappedFile file;
+
+			if (!file.Open(sFileName))
+				return false;
+
+			Parse(dfDataFile, std::string_view(file.Data(), file.Size()));
+			return true;
+		}
+
+		// Same as Read, but the text is already in memory
+		static void Parse(DataFile& dfDataFile, std::string_view sData)
+		{
+			TreeBuilder builder;
+			builder.stack.push(dfDataFile);
+
+			detail::DataParseState state;
+			detail::ParseDataBuffer(sData.data(), sData.size(), state, builder);
+		}
+
+		// Same as Read, but the file is cut between top level objects
+		// and the parts are parsed on the pool, then put together in order
+		static bool ReadParallel(DataFile& dfDataFile, const std::string& sFileName, ThreadPool& pool = ThreadPool::Default())
+		{
+			// Nothing to gain from the cutting
+			if (pool.ThreadCount() < 2)
+				return Read(dfDataFile, sFileName);
+
+			MappedFile file;
+
+			if (!file.Open(sFileName))
+				return false;
+
+			std::vector<size_t> vecSplits = detail::SplitDataBuffer(file.Data(), file.Size(), pool.ThreadCount() * 4);
+			std::vector<DataFile> vecParts(vecSplits.size() - 1);
+
+			pool.ParallelFor(0, vecParts.size(),
+				[&](size_t i)
+				{
+					TreeBuilder builder;
+					builder.stack.push(vecParts[i]);
+
+					detail::DataParseState state;
+					detail::ParseDataBuffer(file.Data() + vecSplits[i], vecSplits[i + 1] - vecSplits[i], state, builder);
+				}, 1);
+
+			for (auto& dfPart : vecParts)
+			{
+				if (dfDataFile.vecObjects.empty() && !dfDataFile.m_bAssigned)
+					dfDataFile = std::move(dfPart);
+				else
+					Merge(dfDataFile, std::move(dfPart));
+			}
+
+			return true;
+		}
+
+		// Goes through the file without building the tree, so memory use doesn't
+		// depend on the size of the file. Handler gets the same events
+		// the tree is built from:
+		//   OnBegin(std::string_view sName)                          object starts
+		//   OnField(std::string_view sName, std::string_view sValue) for every value
+		//   OnEnd()                                                  object ends
+		// Views are valid only during the call
+		template <typename Handler>
+		static bool Scan(const std::string& sFileName, Handler& handler, size_t nBufferSize = 1 << 20)
+		{
+			std::ifstream file(sFileName, std::ios::binary);
+
+			if (!file.is_open())
+				return false;
+
+			std::vector<char> vecBuffer(nBufferSize > 0 ? nBufferSize : 1);
+			size_t nUsed = 0;
+
+			detail::DataParseState state;
+
+			// Name of an object can be on the line that was before
+			// the buffer moved, so it's kept here
+			std::string sName;
+
+			while (true)
+			{
+				file.read(vecBuffer.data() + nUsed, std::streamsize(vecBuffer.size() - nUsed));
+				nUsed += size_t(file.gcount());
+
+				if (!file)
+				{
+					// That's the end, so the last line doesn't need a new line
+					detail::ParseDataBuffer(vecBuffer.data(), nUsed, state, handler);
+					return !file.bad();
+				}
+
+				// Parse only full lines
+				size_t nLines = nUsed;
+
+				while (nLines > 0 && vecBuffer[nLines - 1] != '\n')
+					nLines--;
+
+				if (nLines == 0)
+				{
+					// The line doesn't fit into the buffer
+					vecBuffer.resize(vecBuffer.size() * 2);
+					continue;
+				}
+
+				detail::ParseDataBuffer(vecBuffer.data(), nLines, state, handler);
+
+				if (state.sName.data() >= vecBuffer.data() && state.sName.data() < vecBuffer.data() + vecBuffer.size())
+				{
+					sName = state.sName;
+					state.sName = sName;
+				}
+
+				// Move the rest of the line to the beginning
+				nUsed -= nLines;
+				memmove(vecBuffer.data(), vecBuffer.data() + nLines, nUsed);
+			}
+		}
+
+		static bool WriteBinary(const DataFile& dfDataFile, const std::string& sFileName)
+		{
+			std::function<void(std::string&, const DataFile&)> Encode = [&](std::string& sOut, const DataFile& df)
+			{
+				if (df.vecObjects.empty())
+				{
+					long long nValue = 0;
+					double dValue = 0.0;
+
+					detail::DataBinaryType type = detail::DataBinaryType::String;
+
+					switch (df.GetType())
+					{
+					case Type::String: type = detail::DetectBinaryType(df.String(), nValue, dValue); break;
+					case Type::Int: type = detail::DataBinaryType::Int; nValue = df.Int(); break;
+					case Type::Bool: type = detail::DataBinaryType::Bool; break;
+
+					case Type::Decimal:
+					{
+						// Decimals that don't fit into a double are kept as text
+						dValue = (double)df.Decimal();
+
+						if ((long double)dValue == df.Decimal())
+							type = detail::DataBinaryType::Decimal;
+					}
+					break;
+
+					}
+
+					sOut += char(type);
+
+					switch (type)
+					{
+					case detail::DataBinaryType::Int: detail::AppendBinary(sOut, (int64_t)nValue); break;
+					case detail::DataBinaryType::Decimal: detail::AppendBinary(sOut, dValue); break;
+					case detail::DataBinaryType::Bool: sOut += char(df.Bool()); break;
+
+					default:
+					{
+						const std::string& sValue = df.String();
+
+						detail::AppendBinary(sOut, (uint32_t)sValue.size());
+						sOut += sValue;
+					}
+
+					}
+				}
+				else
+				{
+					size_t nCount = df.vecObjects.size();
+
+					sOut += char(detail::DataBinaryType::Object);
+					detail::AppendBinary(sOut, (uint32_t)nCount);
+
+					// Reserve the offset table, it's filled as children are written
+					size_t nTable = sOut.size();
+					sOut.resize(nTable + nCount * sizeof(uint64_t));
+
+					std::vector<uint32_t> vecSorted(nCount);
+
+					for (size_t i = 0; i < nCount; i++)
+						vecSorted[i] = (uint32_t)i;
+
+					std::sort(vecSorted.begin(), vecSorted.end(),
+						[&](uint32_t a, uint32_t b) { return df.vecObjects[a].first < df.vecObjects[b].first; });
+
+					for (uint32_t nIndex : vecSorted)
+						detail::AppendBinary(sOut, nIndex);
+
+					for (size_t i = 0; i < nCount; i++)
+					{
+						detail::StoreBinary(&sOut[nTable + i * sizeof(uint64_t)], (uint64_t)sOut.size());
+
+						const std::string& sName = df.vecObjects[i].first;
+
+						detail::AppendBinary(sOut, (uint32_t)sName.size());
+						sOut += sName;
+
+						Encode(sOut, df.vecObjects[i].second);
+					}
+				}
+			};
+
+			std::string sOut(detail::DataBinaryMagic, sizeof(detail::DataBinaryMagic));
+			Encode(sOut, dfDataFile);
+
+			std::ofstream file(sFileName, std::ios::binary);
+
+			if (!file.is_open())
+				return false;
+
+			// The whole file goes out with a single write
+			file.write(sOut.data(), sOut.size());
+			return file.good();
+		}
+
+		static bool ReadBinary(DataFile& dfDataFile, const std::string& sFileName)
+		{
+			MappedFile file;
+
+			if (!file.Open(sFileName))
+				return false;
+
+			const char* pData = file.Data();
+			size_t nSize = file.Size();
+
+			if (nSize < sizeof(detail::DataBinaryMagic) || memcmp(pData, detail::DataBinaryMagic, sizeof(detail::DataBinaryMagic)) != 0)
+				return false;
+
+			// Returns where the node ends or 0 if the file is broken, nodes
+			// that were decoded before that are kept. Every entry must start
+			// right where the previous one ended, so no bytes are shared
+			// and no node is decoded twice: the work is linear in the file size
+			std::function<size_t(DataFile&, size_t, size_t)> Decode = [&](DataFile& df, size_t nOffset, size_t nDepth) -> size_t
+			{
+				uint8_t nType;
+
+				if (nDepth > 256 || !detail::ReadBinaryValue(pData, nSize, nOffset, nType))
+					return 0;
+
+				nOffset++;
+
+				switch (detail::DataBinaryType(nType))
+				{
+				case detail::DataBinaryType::Object:
+				{
+					uint32_t nCount;
+
+					if (!detail::ReadBinaryValue(pData, nSize, nOffset, nCount))
+						return 0;
+
+					size_t nTable = nOffset + sizeof(uint32_t);
+
+					// Both tables must fit before the first entry
+					if ((nSize - nTable) / (sizeof(uint64_t) + sizeof(uint32_t)) < nCount)
+						return 0;
+
+					nOffset = nTable + nCount * (sizeof(uint64_t) + sizeof(uint32_t));
+
+					for (uint32_t i = 0; i < nCount; i++)
+					{
+						uint64_t nEntry;
+						uint32_t nKeyLength;
+
+						if (!detail::ReadBinaryValue(pData, nSize, nTable + i * sizeof(uint64_t), nEntry) ||
+							nEntry != nOffset ||
+							!detail::ReadBinaryValue(pData, nSize, nEntry, nKeyLength) ||
+							nSize - nEntry - sizeof(uint32_t) < nKeyLength)
+							return 0;
+
+						std::string sName(pData + nEntry + sizeof(uint32_t), nKeyLength);
+
+						nOffset = Decode(df[sName], nEntry + sizeof(uint32_t) + nKeyLength, nDepth + 1);
+
+						if (nOffset == 0)
+							return 0;
+					}
+
+					return nOffset;
+				}
+
+				case detail::DataBinaryType::String:
+				{
+					uint32_t nLength;
+
+					if (!detail::ReadBinaryValue(pData, nSize, nOffset, nLength) ||
+						nSize - nOffset - sizeof(uint32_t) < nLength)
+						return 0;
+
+					df.SetString(std::string(pData + nOffset + sizeof(uint32_t), nLength));
+
+					return nOffset + sizeof(uint32_t) + nLength;
+				}
+
+				case detail::DataBinaryType::Int:
+				{
+					int64_t nValue;
+
+					if (!detail::ReadBinaryValue(pData, nSize, nOffset, nValue))
+						return 0;
+
+					df.SetInt(nValue);
+
+					return nOffset + sizeof(int64_t);
+				}
+
+				case detail::DataBinaryType::Decimal:
+				{
+					double dValue;
+
+					if (!detail::ReadBinaryValue(pData, nSize, nOffset, dValue))
+						return 0;
+
+					df.SetDecimal(dValue);
+
+					return nOffset + sizeof(double);
+				}
+
+				case detail::DataBinaryType::Bool:
+				{
+					uint8_t nValue;
+
+					if (!detail::ReadBinaryValue(pData, nSize, nOffset, nValue))
+						return 0;
+
+					df.SetBool(nValue != 0);
+
+					return nOffset + sizeof(uint8_t);
+				}
+
+				default: return 0;
+
+				}
+			};
+
+			return Decode(dfDataFile, sizeof(detail::DataBinaryMagic), 0) != 0;
+		}
+
+	private:
+		static constexpr size_t nWriteBlockSize = 1 << 20;
+
+		enum : uint8_t
+		{
+			CachedString = 1 << 0,
+			CachedInt = 1 << 1,
+			CachedDecimal = 1 << 2
+		};
+
+		void SetType(Type type, uint8_t nCached)
+		{
+			m_type = type;
+			m_nCached = nCached;
+			m_bDirty = true;
+			m_bAssigned = true;
+		}
+
+		// Numbers are kept only if the whole text is one, so the result is
+		// the same as parsing it later. The rest (and texts that aren't
+		// numbers at all) go through ParseInt and ParseDecimal on access
+		void CacheNumbers()
+		{
+			const char* pBegin = m_sValue.data();
+			const char* pEnd = pBegin + m_sValue.size();
+
+			if (pBegin == pEnd)
+				return;
+
+			auto [pInt, ecInt] = std::from_chars(pBegin, pEnd, m_nValue);
+
+			if (ecInt == std::errc() && pInt == pEnd)
+			{
+				m_dValue = (long double)m_nValue;
+				m_nCached |= CachedInt | CachedDecimal;
+				return;
+			}
+
+			// Most of the values are words, they can't be decimals
+			char c = *pBegin;
+
+			if (isdigit((unsigned char)c) || c == '-' || c == '.' || c == 'i' || c == 'n' || c == 'I' || c == 'N')
+			{
+				auto [pDec, ecDec] = std::from_chars(pBegin, pEnd, m_dValue);
+
+				if (ecDec == std::errc() && pDec == pEnd)
+					m_nCached |= CachedDecimal;
+			}
+		}
+
+		// Text of the object in the same format Write produces
+		static void AppendText(std::string& sOut, const std::string& sName, const DataFile& df, size_t nTabs)
+		{
+			sOut.append(nTabs, '\t');
+			sOut += sName;
+
+			// Check if there are no other objects
+			if (df.vecObjects.empty())
+			{
+				sOut += " = ";
+				sOut += df.String();
+				sOut += ";\n";
+			}
+			else
+			{
+				sOut += '\n';
+				sOut.append(nTabs, '\t');
+				sOut += "{\n";
+
+				for (const auto& [sChildName, dfChild] : df.vecObjects)
+					AppendText(sOut, sChildName, dfChild, nTabs + 1);
+
+				sOut.append(nTabs, '\t');
+				sOut += "}\n";
+			}
+		}
+
+		static bool IsDirty(const DataFile& df)
+		{
+			if (df.m_bDirty)
+				return true;
+
+			for (const auto& obj : df.vecObjects)
+			{
+				if (IsDirty(obj.second))
+					return true;
 			}
 
-			// ... else error was occured,
-			// but we don't care about it's type
 			return false;
 		}
 
-	public:
-		// Just container to store values of light-weight type as string
-		std::string sValue;
+		static void ClearDirty(DataFile& df)
+		{
+			df.m_bDirty = false;
+
+			for (auto& obj : df.vecObjects)
+				ClearDirty(obj.second);
+		}
+
+		// Builds the tree from the grammar events
+		struct TreeBuilder
+		{
+			std::stack<std::reference_wrapper<DataFile>> stack;
+
+			void OnField(std::string_view sName, std::string_view sValue)
+			{
+				stack.top().get()[std::string(sName)].SetString(std::string(sValue));
+			}
+
+			void OnBegin(std::string_view sName)
+			{
+				// Push it as an object to the stack
+				stack.push(stack.top().get()[std::string(sName)]);
+			}
+
+			void OnEnd()
+			{
+				// Remove it from the stack, but never the root
+				if (stack.size() > 1)
+					stack.pop();
+			}
+		};
+
+		// Same result as if objects of dfSource were read
+		// into dfDest right after its own ones
+		static void Merge(DataFile& dfDest, DataFile&& dfSource)
+		{
+			// Empty text is a value too, so only objects that
+			// were never set keep the value of the destination
+			if (dfSource.m_bAssigned)
+			{
+				dfDest.m_sValue = std::move(dfSource.m_sValue);
+				dfDest.m_nValue = dfSource.m_nValue;
+				dfDest.m_dValue = dfSource.m_dValue;
+				dfDest.m_type = dfSource.m_type;
+				dfDest.m_nCached = dfSource.m_nCached;
+				dfDest.m_bDirty = true;
+				dfDest.m_bAssigned = true;
+			}
+
+			for (auto& [sName, dfChild] : dfSource.vecObjects)
+			{
+				auto [it, bInserted] = dfDest.mapObjects.try_emplace(sName, dfDest.vecObjects.size());
+
+				if (bInserted)
+				{
+					dfDest.vecObjects.push_back({ std::move(sName), std::move(dfChild) });
+					dfDest.m_bDirty = true;
+				}
+				else
+					Merge(dfDest.vecObjects[it->second].second, std::move(dfChild));
+			}
+		}
+
+		// Index of the object in vecObjects, it's created if there is no such.
+		// Only one hash lookup is made either way
+		size_t ChildIndex(const std::string& key)
+		{
+			auto [it, bInserted] = mapObjects.try_emplace(key, vecObjects.size());
+
+			if (bInserted)
+			{
+				vecObjects.push_back({ key, DataFile() });
+				m_bDirty = true;
+			}
 
+			return it->second;
+		}
+
+	private:
+		// Value is stored as the type it was set with, other slots keep
+		// the conversions made by the setter, so a number is parsed
+		// or formatted only once
+		std::string m_sValue;
+		long long m_nValue = 0;
+		long double m_dValue = 0.0;
+
+		Type m_type = Type::String;
+		uint8_t m_nCached = CachedString;
+
+		// Value or list of objects has changed since
+		// the last save of a CachedWriter
+		bool m_bDirty = true;
+
+		// One of the setters was called
+		bool m_bAssigned = false;
+
+	public:
 		// Store name of the object and object by itself
 		std::vector<std::pair<std::string, DataFile>> vecObjects;
 
@@ -331,4 +1275,787 @@ namespace sfl
 		std::unordered_map<std::string, size_t>		  mapObjects;
 
 	};
+
+	// Reads a file written by DataFile::WriteBinary in place:
+	// nothing is decoded until it's asked for, so opening
+	// only maps the file and lookups skip whole subtrees
+	class DataFileView
+	{
+	public:
+		class Node
+		{
+		public:
+			Node() = default;
+			Node(const DataFileView* pView, size_t nOffset) : m_pView(pView), m_nOffset(nOffset) {}
+
+		public:
+			bool Valid() const
+			{
+				uint8_t nType;
+				return m_pView && detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset, nType) && nType <= uint8_t(detail::DataBinaryType::Bool);
+			}
+
+			explicit operator bool() const
+			{
+				return Valid();
+			}
+
+			bool IsObject() const
+			{
+				return Valid() && Type() == detail::DataBinaryType::Object;
+			}
+
+			size_t ChildCount() const
+			{
+				uint32_t nCount = 0;
+
+				if (IsObject())
+					detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1, nCount);
+
+				return nCount;
+			}
+
+			std::string_view Key(size_t nIndex) const
+			{
+				size_t nEntry = Entry(nIndex);
+				uint32_t nKeyLength;
+
+				if (nEntry == 0 || !detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), nEntry, nKeyLength) ||
+					m_pView->Size() - nEntry - sizeof(uint32_t) < nKeyLength)
+					return {};
+
+				return std::string_view(m_pView->Data() + nEntry + sizeof(uint32_t), nKeyLength);
+			}
+
+			Node Child(size_t nIndex) const
+			{
+				std::string_view sKey = Key(nIndex);
+
+				if (!sKey.data())
+					return {};
+
+				return Node(m_pView, size_t(sKey.data() + sKey.size() - m_pView->Data()));
+			}
+
+			// Binary search over the sorted table,
+			// returns an invalid node if there is no such child
+			Node Find(std::string_view sKey) const
+			{
+				size_t nCount = ChildCount();
+				size_t nSorted = m_nOffset + 1 + sizeof(uint32_t) + nCount * sizeof(uint64_t);
+
+				size_t nLow = 0;
+				size_t nHigh = nCount;
+
+				while (nLow < nHigh)
+				{
+					size_t nMiddle = nLow + (nHigh - nLow) / 2;
+					uint32_t nIndex;
+
+					if (!detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), nSorted + nMiddle * sizeof(uint32_t), nIndex))
+						return {};
+
+					std::string_view sMiddle = Key(nIndex);
+
+					if (!sMiddle.data())
+						return {};
+
+					if (sMiddle == sKey)
+						return Child(nIndex);
+
+					if (sMiddle < sKey)
+						nLow = nMiddle + 1;
+					else
+						nHigh = nMiddle;
+				}
+
+				return {};
+			}
+
+			Node operator[](std::string_view sKey) const
+			{
+				return Find(sKey);
+			}
+
+			std::string String() const
+			{
+				if (!Valid())
+					return {};
+
+				switch (Type())
+				{
+				case detail::DataBinaryType::String:
+				{
+					uint32_t nLength;
+
+					if (!detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1, nLength) ||
+						m_pView->Size() - m_nOffset - 1 - sizeof(uint32_t) < nLength)
+						return {};
+
+					return std::string(m_pView->Data() + m_nOffset + 1 + sizeof(uint32_t), nLength);
+				}
+
+				case detail::DataBinaryType::Int: return detail::FormatInt(Int());
+				case detail::DataBinaryType::Decimal: return detail::FormatDecimal(Decimal());
+				case detail::DataBinaryType::Bool: return Bool() ? "1" : "0";
+
+				default: return {};
+
+				}
+			}
+
+			long long Int() const
+			{
+				if (!Valid())
+					return 0;
+
+				switch (Type())
+				{
+				case detail::DataBinaryType::Int:
+				{
+					int64_t nValue = 0;
+					detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1, nValue);
+					return nValue;
+				}
+
+				case detail::DataBinaryType::Decimal:
+				{
+					long double dValue = Decimal();
+
+					if (detail::FitsInt(dValue))
+						return (long long)dValue;
+
+					return detail::ParseInt(String());
+				}
+
+				case detail::DataBinaryType::Bool: return Bool();
+				case detail::DataBinaryType::String: return detail::ParseInt(String());
+
+				default: return 0;
+
+				}
+			}
+
+			long double Decimal() const
+			{
+				if (!Valid())
+					return 0.0;
+
+				switch (Type())
+				{
+				case detail::DataBinaryType::Decimal:
+				{
+					double dValue = 0.0;
+					detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1, dValue);
+					return dValue;
+				}
+
+				case detail::DataBinaryType::Int: return (long double)Int();
+				case detail::DataBinaryType::Bool: return Bool() ? 1.0L : 0.0L;
+				case detail::DataBinaryType::String: return detail::ParseDecimal(String());
+
+				default: return 0.0;
+
+				}
+			}
+
+			bool Bool() const
+			{
+				if (Valid() && Type() == detail::DataBinaryType::Bool)
+				{
+					uint8_t nValue = 0;
+					detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1, nValue);
+					return nValue != 0;
+				}
+
+				return Int() != 0;
+			}
+
+		private:
+			detail::DataBinaryType Type() const
+			{
+				return detail::DataBinaryType(m_pView->Data()[m_nOffset]);
+			}
+
+			// Returns 0 if there is no such entry,
+			// it can't be a real offset because of the header
+			size_t Entry(size_t nIndex) const
+			{
+				uint64_t nEntry = 0;
+
+				if (nIndex >= ChildCount() ||
+					!detail::ReadBinaryValue(m_pView->Data(), m_pView->Size(), m_nOffset + 1 + sizeof(uint32_t) + nIndex * sizeof(uint64_t), nEntry) ||
+					nEntry < sizeof(detail::DataBinaryMagic))
+					return 0;
+
+				return size_t(nEntry);
+			}
+
+		private:
+			const DataFileView* m_pView = nullptr;
+			size_t m_nOffset = 0;
+
+		};
+
+	public:
+		bool Open(const std::string& sFileName)
+		{
+			if (!m_file.Open(sFileName))
+				return false;
+
+			if (m_file.Size() < sizeof(detail::DataBinaryMagic) || memcmp(m_file.Data(), detail::DataBinaryMagic, sizeof(detail::DataBinaryMagic)) != 0)
+			{
+				m_file.Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void Close()
+		{
+			m_file.Close();
+		}
+
+		bool IsOpen() const
+		{
+			return m_file.IsOpen();
+		}
+
+		Node Root() const
+		{
+			if (!IsOpen())
+				return {};
+
+			return Node(this, sizeof(detail::DataBinaryMagic));
+		}
+
+		Node operator[](std::string_view sKey) const
+		{
+			return Root()[sKey];
+		}
+
+		const char* Data() const
+		{
+			return m_file.Data();
+		}
+
+		size_t Size() const
+		{
+			return m_file.Size();
+		}
+
+	private:
+		MappedFile m_file;
+
+	};
+
+	// Same tree as DataFile, but all nodes live in one vector,
+	// all strings in a few big blocks and every key is stored once.
+	// Loading doesn't make an allocation per node and destruction
+	// just frees the blocks
+	class DataDocument
+	{
+	public:
+		using NodeId = uint32_t;
+		static constexpr NodeId npos = ~NodeId(0);
+
+	private:
+		struct NodeData
+		{
+			NodeId nKey = 0;
+			NodeId nParent = npos;
+
+			NodeId nFirstChild = npos;
+			NodeId nLastChild = npos;
+			NodeId nNextSibling = npos;
+			uint32_t nChildCount = 0;
+
+			std::string_view sValue;
+		};
+
+	public:
+		// Lightweight handle to a node, it stays valid
+		// while the document is alive
+		class Node
+		{
+		public:
+			Node() = default;
+			Node(DataDocument* pDoc, NodeId nId) : m_pDoc(pDoc), m_nId(nId) {}
+
+		public:
+			bool Valid() const
+			{
+				return m_pDoc && m_nId != npos;
+			}
+
+			explicit operator bool() const
+			{
+				return Valid();
+			}
+
+			NodeId Id() const
+			{
+				return m_nId;
+			}
+
+			std::string_view Key() const
+			{
+				return m_pDoc->m_vecKeys[Data().nKey];
+			}
+
+			std::string_view String() const
+			{
+				return Data().sValue;
+			}
+
+			// Parsed and formatted the same way as DataFile does
+			long long Int() const
+			{
+				return detail::ParseInt(String());
+			}
+
+			long double Decimal() const
+			{
+				return detail::ParseDecimal(String());
+			}
+
+			bool Bool() const
+			{
+				return Int() != 0;
+			}
+
+			void SetString(std::string_view sValue)
+			{
+				Data().sValue = m_pDoc->Store(sValue);
+			}
+
+			void SetInt(long long nValue)
+			{
+				SetString(detail::FormatInt(nValue));
+			}
+
+			void SetDecimal(long double dValue)
+			{
+				SetString(detail::FormatDecimal(dValue));
+			}
+
+			void SetBool(bool bValue)
+			{
+				SetString(bValue ? "1" : "0");
+			}
+
+			bool HasProperty(std::string_view sKey) const
+			{
+				return Find(sKey).Valid();
+			}
+
+			// Creates the child if there is no such
+			Node operator[](std::string_view sKey)
+			{
+				return Node(m_pDoc, m_pDoc->GetChild(m_nId, sKey));
+			}
+
+			// Never creates anything, returns invalid node on miss
+			Node Find(std::string_view sKey) const
+			{
+				return Node(m_pDoc, m_pDoc->FindChild(m_nId, sKey));
+			}
+
+			size_t ChildCount() const
+			{
+				return Data().nChildCount;
+			}
+
+			class Iterator
+			{
+			public:
+				Iterator(DataDocument* pDoc, NodeId nId) : m_pDoc(pDoc), m_nId(nId) {}
+
+				Node operator*() const { return Node(m_pDoc, m_nId); }
+				bool operator!=(const Iterator& other) const { return m_nId != other.m_nId; }
+
+				Iterator& operator++()
+				{
+					m_nId = m_pDoc->m_vecNodes[m_nId].nNextSibling;
+					return *this;
+				}
+
+			private:
+				DataDocument* m_pDoc;
+				NodeId m_nId;
+			};
+
+			// Children in the order they were added
+			Iterator begin() const { return Iterator(m_pDoc, Data().nFirstChild); }
+			Iterator end() const { return Iterator(m_pDoc, npos); }
+
+		private:
+			NodeData& Data() const
+			{
+				return m_pDoc->m_vecNodes[m_nId];
+			}
+
+		private:
+			DataDocument* m_pDoc = nullptr;
+			NodeId m_nId = npos;
+
+		};
+
+	public:
+		DataDocument()
+		{
+			Clear();
+		}
+
+		DataDocument(const DataDocument&) = delete;
+		DataDocument& operator=(const DataDocument&) = delete;
+
+		DataDocument(DataDocument&&) = default;
+		DataDocument& operator=(DataDocument&&) = default;
+
+	public:
+		Node Root()
+		{
+			return Node(this, 0);
+		}
+
+		Node operator[](std::string_view sKey)
+		{
+			return Root()[sKey];
+		}
+
+		size_t NodeCount() const
+		{
+			return m_vecNodes.size();
+		}
+
+		// Drops everything but keeps the first block
+		// and the vectors' capacity for the next load
+		void Clear()
+		{
+			m_file.Close();
+
+			if (m_vecBlocks.size() > 1)
+				m_vecBlocks.resize(1);
+
+			m_nBlockUsed = 0;
+			m_vecBigStrings.clear();
+
+			m_vecNodes.clear();
+			m_vecKeys.clear();
+			std::fill(m_vecKeyTable.begin(), m_vecKeyTable.end(), npos);
+			std::fill(m_vecChildTable.begin(), m_vecChildTable.end(), npos);
+
+			// Root has an empty key
+			m_vecNodes.push_back(NodeData());
+			m_vecNodes[0].nKey = InternKey("");
+		}
+
+		// Maps the file and keeps the mapping: keys and values
+		// stay views into it and only strings set later
+		// (or values with quotes) are copied into the arena
+		static bool Read(DataDocument& doc, const std::string& sFileName)
+		{
+			doc.Clear();
+
+			if (!doc.m_file.Open(sFileName))
+				return false;
+
+			Builder builder(doc);
+			detail::DataParseState state;
+
+			detail::ParseDataBuffer(doc.m_file.Data(), doc.m_file.Size(), state, builder);
+
+			return true;
+		}
+
+		// Keys and values may be views into the file the document was read
+		// from, so the text is made first and goes to a temporary file that
+		// replaces the target at the end: the mapped file is never truncated
+		static bool Write(DataDocument& doc, const std::string& sFileName)
+		{
+			std::string sOut;
+
+			std::function<void(Node, size_t)> Append = [&](Node node, size_t tabs)
+			{
+				for (Node child : node)
+				{
+					sOut.append(tabs, '\t');
+					sOut += child.Key();
+
+					if (child.ChildCount() == 0)
+					{
+						sOut += " = ";
+						sOut += child.String();
+						sOut += ";\n";
+					}
+					else
+					{
+						sOut += '\n';
+						sOut.append(tabs, '\t');
+						sOut += "{\n";
+
+						Append(child, tabs + 1);
+
+						sOut.append(tabs, '\t');
+						sOut += "}\n";
+					}
+				}
+			};
+
+			Append(doc.Root(), 0);
+
+			std::string sTempName = sFileName + ".tmp";
+
+			{
+				std::ofstream file(sTempName);
+
+				if (!file.is_open())
+					return false;
+
+				file.write(sOut.data(), sOut.size());
+
+				if (!file.good())
+				{
+					file.close();
+					std::remove(sTempName.c_str());
+					return false;
+				}
+			}
+
+			std::error_code ec;
+			std::filesystem::rename(sTempName, sFileName, ec);
+
+			if (ec)
+			{
+				std::remove(sTempName.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+	private:
+		struct Builder
+		{
+			Builder(DataDocument& doc) : doc(doc) { vecStack.push_back(0); }
+
+			void OnField(std::string_view sName, std::string_view sValue)
+			{
+				NodeId nId = doc.GetChild(vecStack.back(), sName);
+				doc.m_vecNodes[nId].sValue = doc.Keep(sValue);
+			}
+
+			void OnBegin(std::string_view sName)
+			{
+				vecStack.push_back(doc.GetChild(vecStack.back(), sName));
+			}
+
+			void OnEnd()
+			{
+				if (vecStack.size() > 1)
+					vecStack.pop_back();
+			}
+
+			DataDocument& doc;
+			std::vector<NodeId> vecStack;
+		};
+
+		static uint64_t Hash(std::string_view s)
+		{
+			// FNV-1a
+			uint64_t h = 14695981039346656037ull;
+
+			for (char c : s)
+				h = (h ^ uint8_t(c)) * 1099511628211ull;
+
+			return h;
+		}
+
+		static uint64_t Hash(NodeId nParent, NodeId nKey)
+		{
+			uint64_t h = (uint64_t(nParent) << 32) | nKey;
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			return h;
+		}
+
+		// Copies string into the arena
+		std::string_view Store(std::string_view s)
+		{
+			if (s.empty())
+				return {};
+
+			if (s.size() > nBlockSize / 4)
+			{
+				// Big strings get their own allocation, so the current
+				// block isn't wasted and every block has nBlockSize bytes
+				m_vecBigStrings.push_back(std::make_unique<char[]>(s.size()));
+				char* p = m_vecBigStrings.back().get();
+				memcpy(p, s.data(), s.size());
+				return std::string_view(p, s.size());
+			}
+
+			if (m_vecBlocks.empty() || m_nBlockUsed + s.size() > nBlockSize)
+			{
+				m_vecBlocks.push_back(std::make_unique<char[]>(nBlockSize));
+				m_nBlockUsed = 0;
+			}
+
+			char* p = m_vecBlocks.back().get() + m_nBlockUsed;
+			memcpy(p, s.data(), s.size());
+			m_nBlockUsed += s.size();
+
+			return std::string_view(p, s.size());
+		}
+
+		// Views into the mapped file live as long as the document,
+		// so only the rest needs to be copied
+		std::string_view Keep(std::string_view s)
+		{
+			const char* pBegin = m_file.Data();
+
+			if (pBegin && s.data() >= pBegin && s.data() + s.size() <= pBegin + m_file.Size())
+				return s;
+
+			return Store(s);
+		}
+
+		// Open addressing tables keep indices, npos marks a free slot
+		template <typename Equal>
+		static NodeId Probe(const std::vector<NodeId>& vecTable, uint64_t nHash, Equal equal, size_t& nSlot)
+		{
+			size_t nMask = vecTable.size() - 1;
+			nSlot = size_t(nHash) & nMask;
+
+			while (vecTable[nSlot] != npos)
+			{
+				if (equal(vecTable[nSlot]))
+					return vecTable[nSlot];
+
+				nSlot = (nSlot + 1) & nMask;
+			}
+
+			return npos;
+		}
+
+		NodeId FindKey(std::string_view sKey) const
+		{
+			if (m_vecKeyTable.empty())
+				return npos;
+
+			size_t nSlot;
+			return Probe(m_vecKeyTable, Hash(sKey), [&](NodeId k) { return m_vecKeys[k] == sKey; }, nSlot);
+		}
+
+		NodeId InternKey(std::string_view sKey)
+		{
+			if ((m_vecKeys.size() + 1) * 2 > m_vecKeyTable.size())
+			{
+				// Keep table at most half full
+				m_vecKeyTable.assign(std::max<size_t>(64, m_vecKeyTable.size() * 2), npos);
+
+				for (NodeId k = 0; k < m_vecKeys.size(); k++)
+				{
+					size_t nSlot;
+					Probe(m_vecKeyTable, Hash(m_vecKeys[k]), [](NodeId) { return false; }, nSlot);
+					m_vecKeyTable[nSlot] = k;
+				}
+			}
+
+			size_t nSlot;
+			NodeId nKey = Probe(m_vecKeyTable, Hash(sKey), [&](NodeId k) { return m_vecKeys[k] == sKey; }, nSlot);
+
+			if (nKey == npos)
+			{
+				nKey = NodeId(m_vecKeys.size());
+				m_vecKeys.push_back(Keep(sKey));
+				m_vecKeyTable[nSlot] = nKey;
+			}
+
+			return nKey;
+		}
+
+		NodeId FindChild(NodeId nParent, std::string_view sKey) const
+		{
+			NodeId nKey = FindKey(sKey);
+
+			if (nKey == npos || m_vecChildTable.empty())
+				return npos;
+
+			size_t nSlot;
+			return Probe(m_vecChildTable, Hash(nParent, nKey),
+				[&](NodeId n) { return m_vecNodes[n].nParent == nParent && m_vecNodes[n].nKey == nKey; }, nSlot);
+		}
+
+		NodeId GetChild(NodeId nParent, std::string_view sKey)
+		{
+			NodeId nKey = InternKey(sKey);
+
+			if (m_vecNodes.size() * 2 > m_vecChildTable.size())
+			{
+				m_vecChildTable.assign(std::max<size_t>(64, m_vecChildTable.size() * 2), npos);
+
+				// Root isn't anyone's child
+				for (NodeId n = 1; n < m_vecNodes.size(); n++)
+				{
+					size_t nSlot;
+					Probe(m_vecChildTable, Hash(m_vecNodes[n].nParent, m_vecNodes[n].nKey), [](NodeId) { return false; }, nSlot);
+					m_vecChildTable[nSlot] = n;
+				}
+			}
+
+			size_t nSlot;
+			NodeId nChild = Probe(m_vecChildTable, Hash(nParent, nKey),
+				[&](NodeId n) { return m_vecNodes[n].nParent == nParent && m_vecNodes[n].nKey == nKey; }, nSlot);
+
+			if (nChild != npos)
+				return nChild;
+
+			nChild = NodeId(m_vecNodes.size());
+
+			NodeData data;
+			data.nKey = nKey;
+			data.nParent = nParent;
+			m_vecNodes.push_back(data);
+
+			// Link it after the last child
+			NodeData& parent = m_vecNodes[nParent];
+
+			if (parent.nLastChild == npos)
+				parent.nFirstChild = nChild;
+			else
+				m_vecNodes[parent.nLastChild].nNextSibling = nChild;
+
+			parent.nLastChild = nChild;
+			parent.nChildCount++;
+
+			m_vecChildTable[nSlot] = nChild;
+			return nChild;
+		}
+
+	private:
+		static constexpr size_t nBlockSize = 64 * 1024;
+
+		std::vector<NodeData> m_vecNodes;
+
+		// Interned keys and open addressing index over them
+		std::vector<std::string_view> m_vecKeys;
+		std::vector<NodeId> m_vecKeyTable;
+
+		// (parent, key) -> child
+		std::vector<NodeId> m_vecChildTable;
+
+		// Blocks of nBlockSize bytes, strings are put one after another
+		std::vector<std::unique_ptr<char[]>> m_vecBlocks;
+		size_t m_nBlockUsed = 0;
+
+		std::vector<std::unique_ptr<char[]>> m_vecBigStrings;
+
+		// File the document was read from
+		MappedFile m_file;
+
+	};
 }
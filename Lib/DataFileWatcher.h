@@ -0,0 +1,423 @@
+#pragma once
+
+#pragma region license
+/***
+*	BSD 3-Clause License
+	Copyright (c) 2021, 2022 Alex
+	All rights reserved.
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***/
+#pragma endregion
+
+#pragma region includes
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "DataFile.h"
+
+#pragma endregion
+
+namespace sfl
+{
+	// Reloads a DataFile when it changes on disk. Parsing happens on
+	// the watcher thread and the new tree replaces the old one with a single
+	// pointer swap, so readers never wait: Get() gives a snapshot
+	// that stays alive for as long as the reader holds it
+	class DataFileWatcher
+	{
+	public:
+		struct Change
+		{
+			enum class Type
+			{
+				Added,
+				Removed,
+				Modified
+			};
+
+			Type type;
+
+			// Keys joined with '/', like in DataFile::Path
+			std::string sPath;
+		};
+
+		// Called on the watcher thread with the new tree
+		// and changes that are related to the path
+		using Callback = std::function<void(const DataFile&, const std::vector<Change>&)>;
+
+	public:
+		DataFileWatcher() = default;
+		DataFileWatcher(const DataFileWatcher&) = delete;
+		DataFileWatcher& operator=(const DataFileWatcher&) = delete;
+
+		~DataFileWatcher()
+		{
+			Stop();
+		}
+
+	public:
+		// Loads the file and starts watching it, nPollMs is how often
+		// the file is checked if there is no inotify
+		bool Start(const std::string& sFileName, int nPollMs = 250)
+		{
+			Stop();
+
+			m_sFileName = sFileName;
+			m_nPollMs = nPollMs;
+
+			// Watching starts before the first load,
+			// so changes made right after it aren't missed
+			OpenNotify();
+
+			std::error_code ec;
+			m_tLastWrite = std::filesystem::last_write_time(m_sFileName, ec);
+
+			if (!Reload())
+			{
+				CloseNotify();
+				return false;
+			}
+
+			m_bRunning = true;
+			m_thWatcher = std::thread(&DataFileWatcher::Watch, this);
+
+			return true;
+		}
+
+		void Stop()
+		{
+			{
+				std::scoped_lock lock(m_muxStop);
+				m_bRunning = false;
+			}
+
+			m_cvStop.notify_all();
+
+			if (m_thWatcher.joinable())
+				m_thWatcher.join();
+
+			CloseNotify();
+		}
+
+		std::shared_ptr<const DataFile> Get() const
+		{
+			return std::atomic_load(&m_pCurrent);
+		}
+
+		// Number of trees that were published
+		uint64_t Version() const
+		{
+			return m_nVersion;
+		}
+
+		// fCallback is called when something at sPath, inside it or one of
+		// its parents is changed, empty path means any change.
+		// Returns an id for RemoveCallback
+		size_t OnChange(const std::string& sPath, Callback fCallback)
+		{
+			std::scoped_lock lock(m_muxCallbacks);
+
+			size_t nId = ++m_nLastCallback;
+			m_vecCallbacks.push_back({ nId, Normalize(sPath), std::move(fCallback) });
+
+			return nId;
+		}
+
+		void RemoveCallback(size_t nId)
+		{
+			std::scoped_lock lock(m_muxCallbacks);
+
+			for (auto it = m_vecCallbacks.begin(); it != m_vecCallbacks.end(); it++)
+			{
+				if (it->nId == nId)
+				{
+					m_vecCallbacks.erase(it);
+					break;
+				}
+			}
+		}
+
+		// Parses the file now, publishes the new tree and calls callbacks
+		// if anything has changed. Returns false if the file can't be read
+		bool Reload()
+		{
+			auto pNew = std::make_shared<DataFile>();
+			std::vector<Change> vecChanges;
+
+			{
+				std::scoped_lock lock(m_muxReload);
+
+				// The file is copied instead of mapped, because an editor can
+				// truncate it while it's parsed and a mapping would crash then
+				std::string sData;
+
+				if (!ReadWhole(sData))
+					return false;
+
+				DataFile::Parse(*pNew, sData);
+
+				std::shared_ptr<const DataFile> pOld = Get();
+
+				if (pOld)
+					Diff(*pOld, *pNew, vecChanges);
+
+				std::atomic_store(&m_pCurrent, std::shared_ptr<const DataFile>(pNew));
+				m_nVersion++;
+			}
+
+			// Callbacks are called without the lock, so they can call Reload
+			if (!vecChanges.empty())
+				Notify(*pNew, vecChanges);
+
+			return true;
+		}
+
+		// Paths that are only in dfOld are Removed, only in dfNew are Added,
+		// and objects with a different value are Modified.
+		// Inside an added or removed object nothing else is reported
+		static void Diff(const DataFile& dfOld, const DataFile& dfNew, std::vector<Change>& vecChanges, const std::string& sPrefix = "")
+		{
+			auto MakePath = [&](const std::string& sKey)
+			{
+				return sPrefix.empty() ? sKey : sPrefix + '/' + sKey;
+			};
+
+			for (const auto& [sKey, dfOldChild] : dfOld.vecObjects)
+			{
+				if (!dfNew.HasProperty(sKey))
+					vecChanges.push_back({ Change::Type::Removed, MakePath(sKey) });
+			}
+
+			for (const auto& [sKey, dfNewChild] : dfNew.vecObjects)
+			{
+				const DataFile* pOldChild = dfOld.Find(sKey);
+
+				if (!pOldChild)
+				{
+					vecChanges.push_back({ Change::Type::Added, MakePath(sKey) });
+					continue;
+				}
+
+				if (pOldChild->vecObjects.empty() != dfNewChild.vecObjects.empty() || pOldChild->String() != dfNewChild.String())
+					vecChanges.push_back({ Change::Type::Modified, MakePath(sKey) });
+
+				Diff(*pOldChild, dfNewChild, vecChanges, MakePath(sKey));
+			}
+		}
+
+	private:
+		struct Subscription
+		{
+			size_t nId;
+			std::string sPath;
+			Callback fCallback;
+		};
+
+		static std::string Normalize(const std::string& sPath)
+		{
+			std::string sOut;
+			DataFile::Path path(sPath);
+
+			for (const auto& sKey : path.Keys())
+			{
+				if (!sOut.empty())
+					sOut += '/';
+
+				sOut += sKey;
+			}
+
+			return sOut;
+		}
+
+		// Checks if sInner is sOuter or lies inside of it
+		static bool IsInside(const std::string& sInner, const std::string& sOuter)
+		{
+			return sOuter.empty() || (sInner.compare(0, sOuter.size(), sOuter) == 0 &&
+				(sInner.size() == sOuter.size() || sInner[sOuter.size()] == '/'));
+		}
+
+		bool ReadWhole(std::string& sData) const
+		{
+			std::ifstream file(m_sFileName, std::ios::binary);
+
+			if (!file.is_open())
+				return false;
+
+			sData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+			return !file.bad();
+		}
+
+		void Notify(const DataFile& dfCurrent, const std::vector<Change>& vecChanges)
+		{
+			// Callbacks are called without the lock,
+			// so they can add or remove callbacks
+			std::vector<Subscription> vecCallbacks;
+
+			{
+				std::scoped_lock lock(m_muxCallbacks);
+				vecCallbacks = m_vecCallbacks;
+			}
+
+			std::vector<Change> vecRelated;
+
+			for (const auto& sub : vecCallbacks)
+			{
+				vecRelated.clear();
+
+				for (const auto& change : vecChanges)
+				{
+					// Value of a parent doesn't change children,
+					// but adding or removing it does
+					if (IsInside(change.sPath, sub.sPath) ||
+						(change.type != Change::Type::Modified && IsInside(sub.sPath, change.sPath)))
+						vecRelated.push_back(change);
+				}
+
+				if (!vecRelated.empty())
+					sub.fCallback(dfCurrent, vecRelated);
+			}
+		}
+
+		void OpenNotify()
+		{
+#if defined(__linux__)
+			// Directory is watched instead of the file, because editors
+			// often write a new file and rename it over the old one
+			std::filesystem::path path(m_sFileName);
+			std::string sDirectory = path.has_parent_path() ? path.parent_path().string() : ".";
+
+			m_nNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+			if (m_nNotify >= 0 && inotify_add_watch(m_nNotify, sDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+				CloseNotify();
+#endif
+		}
+
+		void CloseNotify()
+		{
+#if defined(__linux__)
+			if (m_nNotify >= 0)
+				close(m_nNotify);
+#endif
+
+			m_nNotify = -1;
+		}
+
+		void Watch()
+		{
+#if defined(__linux__)
+			if (m_nNotify >= 0)
+			{
+				std::string sName = std::filesystem::path(m_sFileName).filename().string();
+				alignas(inotify_event) char buf[4096];
+
+				while (m_bRunning)
+				{
+					pollfd pfd{ m_nNotify, POLLIN, 0 };
+
+					if (poll(&pfd, 1, m_nPollMs) <= 0)
+						continue;
+
+					bool bChanged = false;
+					ssize_t nRead;
+
+					while ((nRead = read(m_nNotify, buf, sizeof(buf))) > 0)
+					{
+						for (char* p = buf; p < buf + nRead; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+						{
+							inotify_event* pEvent = (inotify_event*)p;
+
+							if (pEvent->len > 0 && sName == pEvent->name)
+								bChanged = true;
+						}
+					}
+
+					if (bChanged)
+						Reload();
+				}
+
+				return;
+			}
+#endif
+
+			// No inotify, so just check the time of the last change
+			std::unique_lock lock(m_muxStop);
+
+			while (!m_cvStop.wait_for(lock, std::chrono::milliseconds(m_nPollMs), [this]() { return !m_bRunning; }))
+			{
+				std::error_code ec;
+				auto tNow = std::filesystem::last_write_time(m_sFileName, ec);
+
+				if (!ec && tNow != m_tLastWrite)
+				{
+					m_tLastWrite = tNow;
+
+					lock.unlock();
+					Reload();
+					lock.lock();
+				}
+			}
+		}
+
+	private:
+		std::string m_sFileName;
+		int m_nPollMs = 250;
+
+		// inotify descriptor, -1 means the file is polled
+		int m_nNotify = -1;
+		std::filesystem::file_time_type m_tLastWrite;
+
+		std::shared_ptr<const DataFile> m_pCurrent;
+		std::atomic<uint64_t> m_nVersion = 0;
+
+		std::thread m_thWatcher;
+		std::atomic<bool> m_bRunning = false;
+
+		std::mutex m_muxReload;
+
+		std::mutex m_muxStop;
+		std::condition_variable m_cvStop;
+
+		std::mutex m_muxCallbacks;
+		std::vector<Subscription> m_vecCallbacks;
+		size_t m_nLastCallback = 0;
+
+	};
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#pragma region license
+/***
+*	BSD 3-Clause License
+	Copyright (c) 2021, 2022 Alex
+	All rights reserved.
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***/
+#pragma endregion
+
+#pragma region includes
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#pragma endregion
+
+namespace sfl
+{
+	// Maps the whole file into memory, so it can be read
+	// (or written) like a plain array without copying
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& operator=(MappedFile&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+
+				std::swap(m_pData, other.m_pData);
+				std::swap(m_nSize, other.m_nSize);
+				std::swap(m_bWritable, other.m_bWritable);
+				std::swap(m_hFile, other.m_hFile);
+#if defined(_WIN32)
+				std::swap(m_hMapping, other.m_hMapping);
+#endif
+			}
+
+			return *this;
+		}
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+	public:
+		// Opens existing file only for reading
+		bool Open(const std::string& sFileName)
+		{
+			Close();
+
+#if defined(_WIN32)
+			m_hFile = CreateFileA(sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+			if (m_hFile == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER liSize;
+			if (!GetFileSizeEx(m_hFile, &liSize))
+			{
+				Close();
+				return false;
+			}
+
+			m_nSize = size_t(liSize.QuadPart);
+#else
+			m_hFile = open(sFileName.c_str(), O_RDONLY);
+
+			if (m_hFile < 0)
+				return false;
+
+			struct stat st;
+			if (fstat(m_hFile, &st) != 0)
+			{
+				Close();
+				return false;
+			}
+
+			m_nSize = size_t(st.st_size);
+#endif
+
+			// Empty file can't be mapped, but it's still a valid file
+			if (m_nSize == 0)
+				return true;
+
+			if (!Map())
+			{
+				Close();
+				return false;
+			}
+
+#if !defined(_WIN32) && defined(MADV_SEQUENTIAL)
+			madvise(m_pData, m_nSize, MADV_SEQUENTIAL);
+#endif
+
+			return true;
+		}
+
+		// Creates (or truncates) file of the given size
+		// that can be both read and written
+		bool Create(const std::string& sFileName, size_t nSize)
+		{
+			Close();
+
+			m_bWritable = true;
+
+#if defined(_WIN32)
+			m_hFile = CreateFileA(sFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+				CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+			if (m_hFile == INVALID_HANDLE_VALUE)
+			{
+				m_bWritable = false;
+				return false;
+			}
+#else
+			m_hFile = open(sFileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+			if (m_hFile < 0)
+			{
+				m_bWritable = false;
+				return false;
+			}
+#endif
+
+			if (!Resize(nSize))
+			{
+				Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		// Changes size of a writable file, data may move
+		// so old pointers from Data() aren't valid anymore
+		bool Resize(size_t nSize)
+		{
+			if (!m_bWritable)
+				return false;
+
+			Unmap();
+
+#if defined(_WIN32)
+			LARGE_INTEGER liSize;
+			liSize.QuadPart = LONGLONG(nSize);
+
+			if (!SetFilePointerEx(m_hFile, liSize, nullptr, FILE_BEGIN) || !SetEndOfFile(m_hFile))
+				return false;
+#else
+			if (ftruncate(m_hFile, off_t(nSize)) != 0)
+				return false;
+#endif
+
+			m_nSize = nSize;
+
+			return m_nSize == 0 || Map();
+		}
+
+		void Close()
+		{
+			Unmap();
+
+#if defined(_WIN32)
+			if (m_hFile != INVALID_HANDLE_VALUE)
+				CloseHandle(m_hFile);
+
+			m_hFile = INVALID_HANDLE_VALUE;
+#else
+			if (m_hFile >= 0)
+				close(m_hFile);
+
+			m_hFile = -1;
+#endif
+
+			m_nSize = 0;
+			m_bWritable = false;
+		}
+
+		bool IsOpen() const
+		{
+#if defined(_WIN32)
+			return m_hFile != INVALID_HANDLE_VALUE;
+#else
+			return m_hFile >= 0;
+#endif
+		}
+
+		const char* Data() const { return m_pData; }
+		char* Data() { return m_pData; }
+
+		size_t Size() const { return m_nSize; }
+
+	private:
+		bool Map()
+		{
+#if defined(_WIN32)
+			m_hMapping = CreateFileMappingA(m_hFile, nullptr, m_bWritable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+
+			if (!m_hMapping)
+				return false;
+
+			m_pData = (char*)MapViewOfFile(m_hMapping, m_bWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, m_nSize);
+#else
+			void* p = mmap(nullptr, m_nSize, m_bWritable ? PROT_READ | PROT_WRITE : PROT_READ,
+				m_bWritable ? MAP_SHARED : MAP_PRIVATE, m_hFile, 0);
+
+			m_pData = (p == MAP_FAILED) ? nullptr : (char*)p;
+#endif
+
+			return m_pData != nullptr;
+		}
+
+		void Unmap()
+		{
+#if defined(_WIN32)
+			if (m_pData)
+				UnmapViewOfFile(m_pData);
+
+			if (m_hMapping)
+				CloseHandle(m_hMapping);
+
+			m_hMapping = nullptr;
+#else
+			if (m_pData)
+				munmap(m_pData, m_nSize);
+#endif
+
+			m_pData = nullptr;
+		}
+
+	private:
+		char* m_pData = nullptr;
+		size_t m_nSize = 0;
+		bool m_bWritable = false;
+
+#if defined(_WIN32)
+		HANDLE m_hFile = INVALID_HANDLE_VALUE;
+		HANDLE m_hMapping = nullptr;
+#else
+		int m_hFile = -1;
+#endif
+
+	};
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#pragma region license
+/**
+	BSD 3-Clause License
+
+	Copyright (c) 2022, Alex
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma endregion
+
+
+#include "Common.h"
+#include "TSDeque.h"
+#include "Message.h"
+#include "../MappedFile.h"
+
+namespace def
+{
+	namespace net
+	{
+		enum class capture_direction : uint8_t
+		{
+			inbound,
+			outbound
+		};
+
+		// Capture file starts with that header,
+		// then records go one after another
+		struct capture_file_header
+		{
+			char magic[8] = { 'S', 'F', 'L', 'C', 'A', 'P', '0', '1' };
+
+			// Bytes used by header and records, the rest
+			// of the file is preallocated space
+			uint64_t used = 0;
+		};
+
+		template <typename T>
+		struct capture_record
+		{
+			// Nanoseconds since the capture was opened
+			uint64_t time = 0;
+
+			uint32_t connection = 0;
+			capture_direction direction = capture_direction::inbound;
+
+			// header.size bytes of body follow the record
+			message_header<T> header{};
+		};
+
+		// Appends every message it gets into a memory-mapped log,
+		// so the traffic can be replayed later
+		template <typename T>
+		class capture
+		{
+		public:
+			capture() = default;
+			capture(const capture<T>&) = delete;
+
+			~capture()
+			{
+				close();
+			}
+
+		public:
+			bool open(const std::string& file, size_t reserve = 64 * 1024 * 1024)
+			{
+				std::scoped_lock lock(m_muxFile);
+
+				if (!m_file.Create(file, std::max(reserve, sizeof(capture_file_header))))
+					return false;
+
+				m_nUsed = sizeof(capture_file_header);
+				WriteFileHeader();
+
+				m_tpStart = std::chrono::steady_clock::now();
+				return true;
+			}
+
+			// Cuts the preallocated tail off
+			void close()
+			{
+				std::scoped_lock lock(m_muxFile);
+
+				if (m_file.IsOpen())
+				{
+					m_file.Resize(m_nUsed);
+					m_file.Close();
+				}
+			}
+
+			bool is_open()
+			{
+				std::scoped_lock lock(m_muxFile);
+				return m_file.IsOpen();
+			}
+
+			void record(capture_direction direction, uint32_t connection, const message<T>& msg)
+			{
+				std::scoped_lock lock(m_muxFile);
+
+				if (!m_file.IsOpen())
+					return;
+
+				uint64_t time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_tpStart).count());
+				uint64_t size = msg.body.size();
+
+				size_t nNeeded = m_nUsed + sizeof(capture_record<T>) + msg.body.size();
+
+				// Grow file twice so appends stay cheap
+				if (nNeeded > m_file.Size())
+				{
+					if (!m_file.Resize(std::max(nNeeded, m_file.Size() * 2)))
+					{
+						std::cerr << "[CAPTURE] Unable to grow capture file" << std::endl;
+						m_file.Close();
+						return;
+					}
+				}
+
+				// Padding goes to the file too, so the record is zeroed
+				// there first and then the fields are put in one by one
+				char* pRecord = m_file.Data() + m_nUsed;
+				memset(pRecord, 0, sizeof(capture_record<T>));
+
+				constexpr size_t nHeader = offsetof(capture_record<T>, header);
+
+				memcpy(pRecord + offsetof(capture_record<T>, time), &time, sizeof(time));
+				memcpy(pRecord + offsetof(capture_record<T>, connection), &connection, sizeof(connection));
+				memcpy(pRecord + offsetof(capture_record<T>, direction), &direction, sizeof(direction));
+				memcpy(pRecord + nHeader + offsetof(message_header<T>, id), &msg.header.id, sizeof(msg.header.id));
+				memcpy(pRecord + nHeader + offsetof(message_header<T>, size), &size, sizeof(size));
+
+				m_nUsed += sizeof(capture_record<T>);
+
+				if (!msg.body.empty())
+				{
+					memcpy(m_file.Data() + m_nUsed, msg.body.data(), msg.body.size());
+					m_nUsed += msg.body.size();
+				}
+
+				// Keep header up to date, so the capture
+				// is readable even if it wasn't closed
+				WriteFileHeader();
+			}
+
+		private:
+			void WriteFileHeader()
+			{
+				capture_file_header fh;
+				fh.used = m_nUsed;
+
+				memcpy(m_file.Data(), &fh, sizeof(capture_file_header));
+			}
+
+		private:
+			std::mutex m_muxFile;
+			sfl::MappedFile m_file;
+
+			size_t m_nUsed = 0;
+			std::chrono::steady_clock::time_point m_tpStart;
+		};
+
+		template <typename T>
+		struct capture_entry
+		{
+			capture_record<T> record;
+			message<T> msg;
+		};
+
+		// Reads capture file record by record
+		template <typename T>
+		class capture_reader
+		{
+		public:
+			bool open(const std::string& file)
+			{
+				if (!m_file.Open(file) || m_file.Size() < sizeof(capture_file_header))
+					return false;
+
+				capture_file_header fh;
+				memcpy(&fh, m_file.Data(), sizeof(capture_file_header));
+
+				if (memcmp(fh.magic, capture_file_header().magic, sizeof(fh.magic)) != 0)
+					return false;
+
+				m_nEnd = std::min<size_t>(fh.used, m_file.Size());
+				rewind();
+
+				return true;
+			}
+
+			void rewind()
+			{
+				m_nOffset = sizeof(capture_file_header);
+			}
+
+			bool next(capture_entry<T>& entry)
+			{
+				if (m_nOffset + sizeof(capture_record<T>) > m_nEnd)
+					return false;
+
+				memcpy(&entry.record, m_file.Data() + m_nOffset, sizeof(capture_record<T>));
+
+				size_t nBody = size_t(entry.record.header.size);
+
+				// Truncated record
+				if (m_nEnd - m_nOffset - sizeof(capture_record<T>) < nBody)
+					return false;
+
+				m_nOffset += sizeof(capture_record<T>);
+
+				entry.msg.header = entry.record.header;
+				entry.msg.body.assign(m_file.Data() + m_nOffset, m_file.Data() + m_nOffset + nBody);
+
+				m_nOffset += nBody;
+				return true;
+			}
+
+		private:
+			sfl::MappedFile m_file;
+
+			size_t m_nOffset = 0;
+			size_t m_nEnd = 0;
+		};
+
+		// Feeds inbound messages of a capture into an incoming queue
+		// (e.g. server<T>::incoming()), speed 2.0 replays twice faster
+		// than it was recorded and 0 pushes everything without waiting.
+		// Connections of the capture are long gone, so every message gets
+		// the given remote, which is nullptr by default: OnMessage(client, msg)
+		// must check client before using it, or a connection has to be given
+		template <typename T>
+		size_t replay(capture_reader<T>& reader, ts_deque<owned_message<T>>& target, double speed = 1.0,
+			std::shared_ptr<connection<T>> remote = nullptr)
+		{
+			size_t nCount = 0;
+
+			capture_entry<T> entry;
+			auto tpStart = std::chrono::steady_clock::now();
+
+			while (reader.next(entry))
+			{
+				if (entry.record.direction != capture_direction::inbound)
+					continue;
+
+				if (speed > 0.0)
+				{
+					auto tpAt = tpStart + std::chrono::nanoseconds(uint64_t(double(entry.record.time) / speed));
+					std::this_thread::sleep_until(tpAt);
+				}
+
+				target.push_back({ remote, std::move(entry.msg) });
+				nCount++;
+			}
+
+			return nCount;
+		}
+	}
+}
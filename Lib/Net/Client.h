@@ -68,9 +68,13 @@ namespace def
 						m_tsqMessagesIn
 					);
 
+					m_connection->set_max_message_size(m_nMaxMessageSize);
+					m_connection->set_capture(m_pCapture);
+					m_connection->set_stream_handler(m_fnStreamHandler);
+
 					m_connection->connect_server(m_endpoints);
 
-					m_tContext = std::thread([&]() { m_context.run(); });
+					m_tContext = make_pinned_thread(m_nIOCore, [this]() { m_context.run(); });
 				}
 				catch (std::exception& e)
 				{
@@ -84,6 +88,86 @@ namespace def
 				return false;
 			}
 
+#ifdef ASIO_HAS_CO_AWAIT
+			// Coroutine version of connect(), it must be awaited
+			// from a coroutine started with spawn()
+			asio::awaitable<bool> connect_async(const std::string& host, const uint16_t port)
+			{
+				try
+				{
+					asio::ip::tcp::resolver resolver(m_context);
+					m_endpoints = co_await resolver.async_resolve(host, std::to_string(port), asio::use_awaitable);
+
+					m_connection = std::make_unique<connection<T>>(
+						connection<T>::side::client,
+						m_context,
+						asio::ip::tcp::socket(m_context),
+						m_tsqMessagesIn
+					);
+
+					m_connection->set_max_message_size(m_nMaxMessageSize);
+					m_connection->set_capture(m_pCapture);
+					m_connection->set_stream_handler(m_fnStreamHandler);
+
+					co_await m_connection->connect_server_async(m_endpoints);
+				}
+				catch (std::exception& e)
+				{
+					std::cerr << "[CLIENT] Unable to connect to " <<
+						host << ": " << e.what() << std::endl;
+
+					co_return false;
+				}
+
+				std::cout << "[CLIENT] Connected!" << std::endl;
+				co_return true;
+			}
+
+			// Messages go straight to the coroutine,
+			// so the incoming queue isn't used
+			asio::awaitable<message<T>> read()
+			{
+				co_return co_await m_connection->read();
+			}
+
+			asio::awaitable<void> write(const message<T>& msg, lane l = lane::normal)
+			{
+				co_await m_connection->write(msg, l);
+			}
+
+			// Runs session on the client's context
+			void spawn(std::function<asio::awaitable<void>()> session)
+			{
+				asio::co_spawn(m_context, std::move(session),
+					[](std::exception_ptr e)
+					{
+						try
+						{
+							if (e)
+								std::rethrow_exception(e);
+						}
+						catch (std::exception& ex)
+						{
+							std::cerr << "[CLIENT] Session: " << ex.what() << std::endl;
+						}
+					}
+				);
+
+				// Context stops when it runs out of work or after disconnect(),
+				// then the session would never run without a restart
+				if (m_context.stopped())
+				{
+					if (m_tContext.joinable())
+						m_tContext.join();
+
+					m_context.restart();
+				}
+
+				if (!m_tContext.joinable())
+					m_tContext = make_pinned_thread(m_nIOCore, [this]() { m_context.run(); });
+			}
+#endif
+
 			void disconnect()
 			{
 				// If connection is valid then we disconnect
@@ -104,10 +188,37 @@ namespace def
 				return false;
 			}
 
-			void send(const message<T>& msg)
+			void send(const message<T>& msg, lane l = lane::normal)
+			{
+				if (connected())
+					m_connection->send(msg, l);
+			}
+
+			void send_stream(T id, stream_source source, lane l = lane::bulk)
 			{
 				if (connected())
-					m_connection->send(msg);
+					m_connection->send_stream(id, std::move(source), l);
+			}
+
+			// All of these must be set before connect()
+			void set_io_core(int core)
+			{
+				m_nIOCore = core;
+			}
+
+			void set_max_message_size(uint64_t size)
+			{
+				m_nMaxMessageSize = size;
+			}
+
+			void set_stream_handler(std::function<void(const stream_chunk<T>&)> handler)
+			{
+				m_fnStreamHandler = std::move(handler);
+			}
+
+			void set_capture(capture<T>* cap)
+			{
+				m_pCapture = cap;
 			}
 
 			ts_deque<owned_message<T>>& messages()
@@ -130,6 +241,11 @@ namespace def
 
 			// Save endpoints
 			asio::ip::tcp::resolver::results_type m_endpoints;
+
+			uint64_t m_nMaxMessageSize = 64 * 1024 * 1024;
+			int m_nIOCore = -1;
+			capture<T>* m_pCapture = nullptr;
+			std::function<void(const stream_chunk<T>&)> m_fnStreamHandler;
 		};
 	}
 }
@@ -41,9 +41,15 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
 #include <optional>
 #include <mutex>
 #include <thread>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
 
 #ifdef _WIN32
 #define _WIN32_WINNT 0x0A00
@@ -53,3 +59,57 @@
 #include <asio.hpp>
 #include <asio/ts/buffer.hpp>
 #include <asio/ts/internet.hpp>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace def
+{
+	namespace net
+	{
+		// Pins the calling thread to the given core, so the scheduler
+		// doesn't migrate it. Memory that thread touches first is then
+		// allocated on the core's NUMA node by the OS
+		inline bool pin_current_thread(int core)
+		{
+			if (core < 0)
+				return false;
+
+#if defined(_WIN32)
+			// Mask has a bit per core of the current processor group
+			if (core >= int(sizeof(DWORD_PTR) * 8))
+				return false;
+
+			return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif defined(__linux__)
+			if (core >= CPU_SETSIZE)
+				return false;
+
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(core, &set);
+
+			return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) == 0;
+#else
+			// No affinity API, so thread stays where it is
+			return false;
+#endif
+		}
+
+		// Starts a thread that pins itself before doing anything else,
+		// core < 0 means no pinning
+		template <typename F>
+		std::thread make_pinned_thread(int core, F&& f)
+		{
+			return std::thread(
+				[core, f = std::forward<F>(f)]() mutable
+				{
+					pin_current_thread(core);
+					f();
+				}
+			);
+		}
+	}
+}
@@ -37,6 +37,7 @@
 #include "Common.h"
 #include "TSDeque.h"
 #include "Message.h"
+#include "Capture.h"
 
 namespace def
 {
@@ -45,6 +46,60 @@ namespace def
 		template <typename T>
 		class server;
 
+		// Wakes up a coroutine that waits for its message to be sent.
+		// It can be fired before the wait starts (send handler may run on
+		// another thread), then the wait completes at once, so it's never lost
+		class write_signal
+		{
+		public:
+			void fire()
+			{
+				std::function<void()> resume;
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_fired = true;
+					resume = std::move(m_resume);
+				}
+
+				if (resume)
+					resume();
+			}
+
+			template <typename Token>
+			auto async_wait(Token&& token)
+			{
+				return asio::async_initiate<Token, void()>(
+					[this](auto handler)
+					{
+						// Handler can be move-only, but std::function wants a copy
+						auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+						auto executor = asio::get_associated_executor(*shared);
+
+						std::function<void()> resume = [shared, executor]()
+						{
+							asio::post(executor, [shared]() { std::move(*shared)(); });
+						};
+
+						std::unique_lock<std::mutex> lock(m_mutex);
+
+						if (m_fired)
+						{
+							lock.unlock();
+							resume();
+						}
+						else
+							m_resume = std::move(resume);
+					}, token);
+			}
+
+		private:
+			std::mutex m_mutex;
+			bool m_fired = false;
+			std::function<void()> m_resume;
+
+		};
+
 		template <typename T>
 		class connection : public std::enable_shared_from_this<connection<T>>
 		{
@@ -104,7 +159,7 @@ namespace def
 				if (m_nOwner == side::client)
 				{
 					asio::async_connect(m_socket, endpoints,
-						[this](asio::error_code ec, asio::ip::tcp::endpoint ep)
+						[this](asio::error_code ec, asio::ip::tcp::endpoint /*ep*/)
 						{
 							if (!ec)
 							{
@@ -132,20 +187,141 @@ namespace def
 				return m_socket.is_open();
 			}
 
-			void send(const message<T>& msg)
+			void send(const message<T>& msg, lane l = lane::normal)
+			{
+				asio::post(m_context,
+					[this, msg, l]()
+					{
+						if (m_pCapture)
+							m_pCapture->record(capture_direction::outbound, m_nID, msg);
+
+						m_arrMessagesOut[size_t(l)].push_back({ msg, nullptr, nullptr });
+
+						// If frames are already being written then the new
+						// message will be picked up by the write loop
+						if (!m_bWriting)
+							WriteFrame();
+					}
+				);
+			}
+
+			// Sends body that doesn't need to be in memory at once,
+			// source is called on the I/O thread for every next chunk
+			// and the other side gets it through the stream handler
+			void send_stream(T id, stream_source source, lane l = lane::bulk)
 			{
 				asio::post(m_context,
-					[this, msg]()
+					[this, id, source = std::move(source), l]() mutable
 					{
-						bool bWasEmpty = m_tsqMessagesOut.empty();
-						m_tsqMessagesOut.push_back(msg);
-						
-						if (bWasEmpty)
-							WriteHeader();
+						outgoing out;
+						out.msg.header.id = id;
+						out.source = std::move(source);
+
+						m_arrMessagesOut[size_t(l)].push_back(std::move(out));
+
+						if (!m_bWriting)
+							WriteFrame();
 					}
 				);
 			}
 
+			// Bodies bigger than that are sent in several frames,
+			// so messages from the higher lanes can get in between
+			void set_chunk_size(uint32_t size)
+			{
+				m_nChunkSize = std::max<uint32_t>(size, 1);
+			}
+
+			// Incoming messages (and single frames) can't be bigger than that,
+			// it's checked before any memory is allocated for a body
+			void set_max_message_size(uint64_t size)
+			{
+				m_nMaxMessageSize = size;
+			}
+
+			// Called on the I/O thread for every chunk of a streamed body
+			void set_stream_handler(std::function<void(const stream_chunk<T>&)> handler)
+			{
+				m_fnStreamHandler = std::move(handler);
+			}
+
+			// Every complete message that goes through the connection
+			// is recorded there, nullptr turns it off
+			void set_capture(capture<T>* cap)
+			{
+				m_pCapture = cap;
+			}
+
+			// Called once the client is validated instead of starting the read loop
+			void set_session(std::function<void(std::shared_ptr<connection<T>>)> session)
+			{
+				m_fnSession = std::move(session);
+			}
+
+#ifdef ASIO_HAS_CO_AWAIT
+			// Coroutine front-end, all of these must be awaited
+			// from a coroutine that runs on the connection's context
+			// and read() can't be mixed with the read loop
+
+			asio::awaitable<message<T>> read()
+			{
+				while (true)
+				{
+					co_await asio::async_read(m_socket, asio::buffer(&m_frameIn, sizeof(frame_header<T>)), asio::use_awaitable);
+
+					uint8_t* pDest;
+
+					if (!BeginFrame(pDest))
+						throw asio::system_error(asio::error::message_size);
+
+					if (m_frameIn.size > 0)
+						co_await asio::async_read(m_socket, asio::buffer(pDest, m_frameIn.size), asio::use_awaitable);
+
+					// Streamed frames go to the stream handler,
+					// so we wait for a whole message
+					if (EndFrame())
+					{
+						if (m_pCapture)
+							m_pCapture->record(capture_direction::inbound, m_nID, m_arrCacheIn[m_frameIn.lane]);
+
+						co_return std::move(m_arrCacheIn[m_frameIn.lane]);
+					}
+				}
+			}
+
+			// Resumes when the message has left the lane,
+			// so the priorities still work with coroutines
+			asio::awaitable<void> write(const message<T>& msg, lane l = lane::normal)
+			{
+				auto done = std::make_shared<write_signal>();
+
+				if (m_pCapture)
+					m_pCapture->record(capture_direction::outbound, m_nID, msg);
+
+				m_arrMessagesOut[size_t(l)].push_back({ msg, nullptr, done });
+
+				if (!m_bWriting)
+					WriteFrame();
+
+				co_await done->async_wait(asio::use_awaitable);
+
+				if (!connected())
+					throw asio::system_error(asio::error::not_connected);
+			}
+
+			asio::awaitable<void> connect_server_async(const asio::ip::tcp::resolver::results_type& endpoints)
+			{
+				co_await asio::async_connect(m_socket, endpoints, asio::use_awaitable);
+
+				// Same validation as ReadValidation() and WriteValidation() do
+				co_await asio::async_read(m_socket, asio::buffer(&m_nKnockIn, sizeof(uint64_t)), asio::use_awaitable);
+				m_nKnockOut = encrypt(m_nKnockIn);
+				co_await asio::async_write(m_socket, asio::buffer(&m_nKnockOut, sizeof(uint64_t)), asio::use_awaitable);
+
+				WriteFrame();
+			}
+#endif
+
 			uint64_t encrypt(uint64_t n)
 			{
 				uint64_t out;
@@ -158,64 +334,107 @@ namespace def
 			}
 
 		private:
-			void WriteHeader()
+			void WriteFrame()
 			{
-				// Writing message header
-				asio::async_write(m_socket, asio::buffer(&m_tsqMessagesOut.front().header, sizeof(message_header<T>)),
-					[this](asio::error_code ec, size_t length)
+				// Always pick the highest lane that has something to send,
+				// so a big message from the bulk lane can't block a small one
+				size_t nLane = 0;
+				while (nLane < lane_count && m_arrMessagesOut[nLane].empty())
+					nLane++;
+
+				if (nLane == lane_count)
+				{
+					// Nothing to send
+					m_bWriting = false;
+					return;
+				}
+
+				m_bWriting = true;
+
+				const outgoing& out = m_arrMessagesOut[nLane].front();
+				size_t nOffset = m_arrOffsetsOut[nLane];
+
+				m_frameOut.id = out.msg.header.id;
+				m_frameOut.lane = uint8_t(nLane);
+				m_frameOut.flags = 0;
+
+				if (nOffset == 0)
+					m_frameOut.flags |= frame_first;
+
+				const uint8_t* pData;
+				size_t nLength;
+
+				if (out.source)
+				{
+					// Pull the next chunk of a stream,
+					// the empty one finishes it
+					m_vecStreamOut.resize(m_nChunkSize);
+					nLength = out.source(m_vecStreamOut.data(), m_vecStreamOut.size());
+					pData = m_vecStreamOut.data();
+
+					m_frameOut.flags |= frame_stream;
+
+					if (nLength == 0)
+						m_frameOut.flags |= frame_last;
+				}
+				else
+				{
+					nLength = std::min<size_t>(out.msg.body.size() - nOffset, m_nChunkSize);
+					pData = out.msg.body.data() + nOffset;
+
+					if (nOffset + nLength == out.msg.body.size())
+						m_frameOut.flags |= frame_last;
+				}
+
+				m_frameOut.size = uint32_t(nLength);
+
+				// Header and body part go with a single write
+				std::array<asio::const_buffer, 2> buffers =
+				{
+					asio::buffer(&m_frameOut, sizeof(frame_header<T>)),
+					asio::buffer(pData, nLength)
+				};
+
+				asio::async_write(m_socket, buffers,
+					[this, nLane, nLength](asio::error_code ec, size_t /*length*/)
 					{
 						if (!ec)
 						{
-							// Check if message has a body
-							if (m_tsqMessagesOut.front().body.size() > 0)
+							if (m_frameOut.flags & frame_last)
 							{
-								// so let's write body
-								WriteBody();
+								// Wake up the coroutine that waits for that message
+								if (m_arrMessagesOut[nLane].front().done)
+									m_arrMessagesOut[nLane].front().done->fire();
+
+								// The whole message was sent,
+								// so remove it from the lane
+								m_arrMessagesOut[nLane].pop_front();
+								m_arrOffsetsOut[nLane] = 0;
 							}
 							else
-							{
-								// it doesn't have a message body
-								// so just remove it
-								m_tsqMessagesOut.pop_front();
+								m_arrOffsetsOut[nLane] += nLength;
 
-								// If the deque isn't empty then there are more messages
-								if (!m_tsqMessagesOut.empty())
-									WriteHeader();
-							}
+							WriteFrame();
 						}
 						else
 						{
 							// if it fails then just write fail reason
 							// and close socket
 							std::cerr << '[' << id() << "] " << ec.message() << std::endl;
+							m_bWriting = false;
 							m_socket.close();
-						}
-					}
-				);
-			}
 
-			void WriteBody()
-			{
-				asio::async_write(m_socket, asio::buffer(m_tsqMessagesOut.front().body.data(), m_tsqMessagesOut.front().body.size()),
-					[this](asio::error_code ec, size_t length)
-					{
-						if (!ec)
-						{
-							// Remove message from queue
-							// because sending was over
-							m_tsqMessagesOut.pop_front();
-
-							// If there are still any messages
-							// then do message stuff again
-							if (!m_tsqMessagesOut.empty())
-								WriteHeader();
-						}
-						else
-						{
-							// if it fails then just write fail reason
-							// and close socket
-							std::cerr << '[' << id() << "] " << ec.message() << std::endl;
-							m_socket.close();
+							// Nothing else will be sent, so don't keep anyone waiting
+							for (auto& queue : m_arrMessagesOut)
+							{
+								while (!queue.empty())
+								{
+									if (queue.front().done)
+										queue.front().done->fire();
+
+									queue.pop_front();
+								}
+							}
 						}
 					}
 				);
@@ -223,23 +442,21 @@ namespace def
 
 			void ReadHeader()
 			{
-				asio::async_read(m_socket, asio::buffer(&m_msgCache.header, sizeof(message_header<T>)),
-					[this](asio::error_code ec, size_t length)
+				asio::async_read(m_socket, asio::buffer(&m_frameIn, sizeof(frame_header<T>)),
+					[this](asio::error_code ec, size_t /*length*/)
 					{
 						if (!ec)
 						{
-							// Check if message has a body
-							if (m_msgCache.header.size > 0)
-							{
-								// Then resize body vector and read it
-								m_msgCache.body.resize(m_msgCache.header.size);
-								ReadBody();
-							}
+							uint8_t* pDest;
+
+							if (!BeginFrame(pDest))
+								return;
+
+							// Check if frame has a body
+							if (m_frameIn.size > 0)
+								ReadBody(pDest);
 							else
-							{
-								// else push it to incoming messages
-								PushToIncomingQueue();
-							}
+								OnFrameRead();
 						}
 						else
 						{
@@ -252,16 +469,14 @@ namespace def
 				);
 			}
 
-			void ReadBody()
+			void ReadBody(uint8_t* pDest)
 			{
-				asio::async_read(m_socket, asio::buffer(m_msgCache.body.data(), m_msgCache.body.size()),
-					[this](asio::error_code ec, size_t length)
+				asio::async_read(m_socket, asio::buffer(pDest, m_frameIn.size),
+					[this](asio::error_code ec, size_t /*length*/)
 					{
 						if (!ec)
 						{
-							// when bytes arrive
-							// we just push message to incoming messages
-							PushToIncomingQueue();
+							OnFrameRead();
 						}
 						else
 						{
@@ -274,21 +489,138 @@ namespace def
 				);
 			}
 
+			void OnFrameRead()
+			{
+				// If that was the last frame then the message is complete
+				// so we push it to incoming messages
+				if (EndFrame())
+					PushToIncomingQueue();
+				else
+					ReadHeader();
+			}
+
+			// Checks just arrived frame header and finds where its body should go,
+			// returns false (and closes the socket) if the frame is invalid
+			bool BeginFrame(uint8_t*& pDest)
+			{
+				// Never trust the size from the other side
+				if (m_frameIn.lane >= lane_count)
+				{
+					std::cerr << '[' << id() << "] Invalid frame lane" << std::endl;
+					m_socket.close();
+					return false;
+				}
+
+				if (m_frameIn.size > m_nMaxMessageSize)
+				{
+					std::cerr << '[' << id() << "] Frame is too big" << std::endl;
+					m_socket.close();
+					return false;
+				}
+
+				if (m_frameIn.flags & frame_stream)
+				{
+					// Streamed body is read into the single chunk buffer
+					// and goes straight to the handler
+					if (m_frameIn.flags & frame_first)
+						m_arrStreamOffsetsIn[m_frameIn.lane] = 0;
+
+					m_vecStreamIn.resize(m_frameIn.size);
+					pDest = m_vecStreamIn.data();
+
+					return true;
+				}
+
+				message<T>& msg = m_arrCacheIn[m_frameIn.lane];
+
+				// First frame of the message so start it from scratch
+				if (m_frameIn.flags & frame_first)
+				{
+					msg.header.id = m_frameIn.id;
+					msg.body.clear();
+				}
+
+				if (msg.body.size() + m_frameIn.size > m_nMaxMessageSize)
+				{
+					std::cerr << '[' << id() << "] Message is too big" << std::endl;
+					m_socket.close();
+					return false;
+				}
+
+				// Grow body vector so the frame
+				// goes right after the previous ones
+				size_t nOffset = msg.body.size();
+				msg.body.resize(nOffset + m_frameIn.size);
+				pDest = msg.body.data() + nOffset;
+
+				return true;
+			}
+
+			// Called when the frame body has arrived,
+			// returns true if a whole message is ready in the lane cache
+			bool EndFrame()
+			{
+				if (m_frameIn.flags & frame_stream)
+				{
+					DeliverStreamChunk();
+					return false;
+				}
+
+				if (m_frameIn.flags & frame_last)
+				{
+					message<T>& msg = m_arrCacheIn[m_frameIn.lane];
+					msg.header.size = msg.body.size();
+					return true;
+				}
+
+				return false;
+			}
+
+			void DeliverStreamChunk()
+			{
+				uint64_t& nOffset = m_arrStreamOffsetsIn[m_frameIn.lane];
+
+				// Nobody listens, so the chunk is just dropped
+				if (m_fnStreamHandler)
+				{
+					stream_chunk<T> chunk;
+
+					if (m_nOwner == side::server)
+						chunk.remote = this->shared_from_this();
+
+					chunk.id = m_frameIn.id;
+					chunk.data = m_vecStreamIn.data();
+					chunk.size = m_vecStreamIn.size();
+					chunk.offset = nOffset;
+					chunk.first = m_frameIn.flags & frame_first;
+					chunk.last = m_frameIn.flags & frame_last;
+
+					m_fnStreamHandler(chunk);
+				}
+
+				nOffset += m_vecStreamIn.size();
+			}
+
 			void PushToIncomingQueue()
 			{
+				message<T>& msg = m_arrCacheIn[m_frameIn.lane];
+
+				if (m_pCapture)
+					m_pCapture->record(capture_direction::inbound, m_nID, msg);
+
 				// Convert to owned_message and save it in queue
 				if (m_nOwner == side::server)
 				{
 					m_tsqMessagesIn.push_back({
 						this->shared_from_this(),
-						m_msgCache
+						std::move(msg)
 					});
 				}
 				else
 				{
 					m_tsqMessagesIn.push_back({
 						nullptr,
-						m_msgCache
+						std::move(msg)
 					});
 				}
 
@@ -299,7 +631,7 @@ namespace def
 			void ReadValidation(server<T>* serv = nullptr)
 			{
 				asio::async_read(m_socket, asio::buffer(&m_nKnockIn, sizeof(uint64_t)),
-					[this, serv](std::error_code ec, std::size_t length)
+					[this, serv](std::error_code ec, std::size_t /*length*/)
 					{
 						if (!ec)
 						{
@@ -311,7 +643,11 @@ namespace def
 									std::cout << "Client Validated" << std::endl;
 									serv->OnClientValidated(this->shared_from_this());
 
-									ReadHeader();
+									// Session reads messages by itself
+									if (m_fnSession)
+										m_fnSession(this->shared_from_this());
+									else
+										ReadHeader();
 								}
 								else
 								{
@@ -338,7 +674,7 @@ namespace def
 			void WriteValidation()
 			{
 				asio::async_write(m_socket, asio::buffer(&m_nKnockOut, sizeof(uint64_t)),
-					[this](std::error_code ec, std::size_t length)
+					[this](std::error_code ec, std::size_t /*length*/)
 					{
 						if (!ec)
 						{
@@ -346,6 +682,9 @@ namespace def
 							// for a response (or a closure)
 							if (m_nOwner == side::client)
 								ReadHeader();
+
+							// Messages sent so far were held back
+							WriteFrame();
 						}
 						else
 						{
@@ -360,9 +699,44 @@ namespace def
 			asio::ip::tcp::socket m_socket;
 			asio::io_context& m_context;
 
-			message<T> m_msgCache;
+			// Messages are reassembled from frames separately for each lane
+			frame_header<T> m_frameIn;
+			std::array<message<T>, lane_count> m_arrCacheIn;
+
+			// Streamed bodies are never collected, only the current chunk is kept
+			std::vector<uint8_t> m_vecStreamIn;
+			std::array<uint64_t, lane_count> m_arrStreamOffsetsIn{};
+			std::function<void(const stream_chunk<T>&)> m_fnStreamHandler;
+
+			std::function<void(std::shared_ptr<connection<T>>)> m_fnSession;
+
+			capture<T>* m_pCapture = nullptr;
+
+			// Message waiting in a lane, if it has a source
+			// then the body is pulled from it chunk by chunk
+			struct outgoing
+			{
+				message<T> msg;
+				stream_source source;
+
+				// Fired when the message is sent
+				std::shared_ptr<write_signal> done;
+			};
+
+			// Outbound lanes and how much of the front message
+			// of each lane was already sent. Lanes are touched
+			// only from handlers on the context, so they need no locks
+			frame_header<T> m_frameOut;
+			std::array<std::deque<outgoing>, lane_count> m_arrMessagesOut;
+			std::array<size_t, lane_count> m_arrOffsetsOut{};
+			std::vector<uint8_t> m_vecStreamOut;
+
+			// Frames can't go before the validation data,
+			// so nothing is written until it's sent
+			bool m_bWriting = true;
+			uint32_t m_nChunkSize = 64 * 1024;
+			uint64_t m_nMaxMessageSize = 64 * 1024 * 1024;
 
-			ts_deque<message<T>> m_tsqMessagesOut;
 			ts_deque<owned_message<T>>& m_tsqMessagesIn;
 
 			uint32_t m_nID = 0;
@@ -44,7 +44,43 @@ namespace def
 		struct message_header
 		{
 			T id{};
+			uint64_t size = 0;
+		};
+
+		// Outbound priority lanes, the lower the value
+		// the sooner message leaves the connection
+		enum class lane : uint8_t
+		{
+			high,
+			normal,
+			bulk
+		};
+
+		constexpr size_t lane_count = 3;
+
+		enum frame_flags : uint8_t
+		{
+			frame_first = 1 << 0,
+			frame_last = 1 << 1,
+
+			// Body isn't collected into a message,
+			// every frame goes to the stream handler as it arrives
+			frame_stream = 1 << 2
+		};
+
+		// That's what actually goes through the socket:
+		// every message is split into one or more frames,
+		// so frames from different lanes can be interleaved
+		template <typename T>
+		struct frame_header
+		{
+			T id{};
+
+			// Size of the body part that follows this header
 			uint32_t size = 0;
+
+			uint8_t lane = 0;
+			uint8_t flags = 0;
 		};
 
 		template <typename T>
@@ -122,5 +158,27 @@ namespace def
 			std::shared_ptr<connection<T>> remote = nullptr;
 			message<T> msg;
 		};
+
+		// Part of a streamed body, data is valid
+		// only while the stream handler is running
+		template <typename T>
+		struct stream_chunk
+		{
+			std::shared_ptr<connection<T>> remote = nullptr;
+			T id{};
+
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+
+			// How many bytes of that stream arrived before this chunk
+			uint64_t offset = 0;
+
+			bool first = false;
+			bool last = false;
+		};
+
+		// Fills buffer with the next part of a streamed body and returns
+		// amount of written bytes, 0 means the end of the stream
+		using stream_source = std::function<size_t(uint8_t*, size_t)>;
 	}
 }
@@ -36,7 +36,9 @@
 
 #include "Common.h"
 #include "TSDeque.h"
+#include "SPSCRing.h"
 #include "Message.h"
+#include "Capture.h"
 #include "Client.h"
 #include "Server.h"
 #include "Connection.h"
@@ -0,0 +1,190 @@
+#pragma once
+
+#pragma region license
+/**
+	BSD 3-Clause License
+
+	Copyright (c) 2022, Alex
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma endregion
+
+
+#include "Common.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+
+namespace def
+{
+	namespace net
+	{
+		// Fixed-capacity ring buffer for exactly one producer and one
+		// consumer thread. Both push_back() and pop_front() are wait-free, there
+		// are no locks at all, so it's a cheaper ts_deque when only
+		// two threads (or even one) touch the queue
+		template <typename T>
+		class spsc_ring
+		{
+		public:
+			// Capacity is rounded up to the power of two
+			explicit spsc_ring(size_t capacity = 1024)
+			{
+				m_nCapacity = 1;
+				while (m_nCapacity < capacity)
+					m_nCapacity <<= 1;
+
+				m_nMask = m_nCapacity - 1;
+				m_pSlots = std::make_unique<slot[]>(m_nCapacity);
+			}
+
+			spsc_ring(const spsc_ring<T>&) = delete;
+
+			~spsc_ring()
+			{
+				while (pop_front());
+			}
+
+		public:
+			// Producer side, returns false (and doesn't touch value)
+			// if the ring is full
+			bool push_back(const T& value)
+			{
+				return emplace_back(value);
+			}
+
+			bool push_back(T&& value)
+			{
+				return emplace_back(std::move(value));
+			}
+
+			template <typename... Args>
+			bool emplace_back(Args&&... args)
+			{
+				size_t tail = m_nTail.load(std::memory_order_relaxed);
+
+				// Cached head saves touching consumer's cache line
+				// until the ring looks full
+				if (tail - m_nHeadCache == m_nCapacity)
+				{
+					m_nHeadCache = m_nHead.load(std::memory_order_acquire);
+
+					if (tail - m_nHeadCache == m_nCapacity)
+						return false;
+				}
+
+				new (m_pSlots[tail & m_nMask].data) T(std::forward<Args>(args)...);
+				m_nTail.store(tail + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			// Consumer side, nullptr if the ring is empty
+			T* front()
+			{
+				size_t head = m_nHead.load(std::memory_order_relaxed);
+
+				if (head == m_nTailCache)
+				{
+					m_nTailCache = m_nTail.load(std::memory_order_acquire);
+
+					if (head == m_nTailCache)
+						return nullptr;
+				}
+
+				return element(head);
+			}
+
+			// Consumer side, false if the ring is empty
+			bool pop_front()
+			{
+				T* value = front();
+
+				if (!value)
+					return false;
+
+				value->~T();
+				m_nHead.store(m_nHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+				return true;
+			}
+
+			bool pop_front(T& out)
+			{
+				T* value = front();
+
+				if (!value)
+					return false;
+
+				out = std::move(*value);
+				return pop_front();
+			}
+
+			bool empty() const
+			{
+				return m_nHead.load(std::memory_order_acquire) == m_nTail.load(std::memory_order_acquire);
+			}
+
+			size_t size() const
+			{
+				return m_nTail.load(std::memory_order_acquire) - m_nHead.load(std::memory_order_acquire);
+			}
+
+			size_t capacity() const
+			{
+				return m_nCapacity;
+			}
+
+		private:
+			struct slot
+			{
+				alignas(T) unsigned char data[sizeof(T)];
+			};
+
+			T* element(size_t i)
+			{
+				return std::launder(reinterpret_cast<T*>(m_pSlots[i & m_nMask].data));
+			}
+
+		private:
+			size_t m_nCapacity = 0;
+			size_t m_nMask = 0;
+			std::unique_ptr<slot[]> m_pSlots;
+
+			// Producer and consumer data live on their own cache lines,
+			// so the two threads don't invalidate each other's caches
+			alignas(64) std::atomic<size_t> m_nHead{ 0 };
+			size_t m_nTailCache = 0;
+
+			// alignas also rounds the size up, so nothing else lands on the tail's line
+			alignas(64) std::atomic<size_t> m_nTail{ 0 };
+			size_t m_nHeadCache = 0;
+		};
+	}
+}
@@ -37,6 +37,7 @@
 #include "Common.h"
 #include "TSDeque.h"
 #include "Message.h"
+#include "Capture.h"
 #include "Connection.h"
 
 namespace def
@@ -55,6 +56,11 @@ namespace def
 			virtual ~server()
 			{
 				stop();
+
+				// Sockets of connections must go before the context,
+				// but the members are destroyed after it
+				m_tsqMessagesIn.clear();
+				m_deqConnections.clear();
 			}
 
 		public:
@@ -66,7 +72,7 @@ namespace def
 				{
 					wait_connection();
 
-					m_tContext = std::thread([this]() { m_context.run(); });
+					m_tContext = make_pinned_thread(m_nIOCore, [this]() { m_context.run(); });
 				}
 				catch (std::exception& e)
 				{
@@ -103,6 +109,43 @@ namespace def
 									m_context, std::move(socket), m_tsqMessagesIn
 								);
 
+							conn->set_max_message_size(m_nMaxMessageSize);
+							conn->set_capture(m_pCapture);
+							conn->set_stream_handler(
+								[this](const stream_chunk<T>& chunk)
+								{
+									OnStreamChunk(chunk.remote, chunk);
+								}
+							);
+
+#ifdef ASIO_HAS_CO_AWAIT
+							if (m_bSessions)
+							{
+								conn->set_session(
+									[this](std::shared_ptr<connection<T>> client)
+									{
+										asio::co_spawn(m_context, OnSession(client),
+											[client](std::exception_ptr e)
+											{
+												try
+												{
+													if (e)
+														std::rethrow_exception(e);
+												}
+												catch (std::exception& ex)
+												{
+													std::cerr << '[' << client->id() << "] Session: " << ex.what() << std::endl;
+												}
+
+												// Session is over so the client is not needed
+												client->disconnect();
+											}
+										);
+									}
+								);
+							}
+#endif
+
 							if (OnClientConnect(conn))
 							{
 								m_deqConnections.push_back(std::move(conn));
@@ -129,13 +172,13 @@ namespace def
 				);
 			}
 
-			void send(std::shared_ptr<connection<T>> client, const message<T>& msg)
+			void send(std::shared_ptr<connection<T>> client, const message<T>& msg, lane l = lane::normal)
 			{
 				if (client && client->connected())
 				{
 					// If client is valid and still connected
 					// then we send message
-					client->send(msg);
+					client->send(msg, l);
 				}
 				else
 				{
@@ -157,7 +200,7 @@ namespace def
 				}
 			}
 
-			void send_all(const message<T>& msg, std::shared_ptr<connection<T>> ignored = nullptr)
+			void send_all(const message<T>& msg, std::shared_ptr<connection<T>> ignored = nullptr, lane l = lane::normal)
 			{
 				bool bAnyInvalid = false;
 
@@ -168,7 +211,7 @@ namespace def
 						// Client is valid and connected
 						// so we just send message if it's not an ignored client
 						if (client != ignored)
-							client->send(msg);
+							client->send(msg, l);
 					}
 					else
 					{
@@ -199,52 +242,114 @@ namespace def
 				}
 			}
 
+			// Pins the I/O thread to the core, must be called before start().
+			// Buffers for incoming frames are allocated by that thread, so they
+			// stay on its NUMA node too. Messages given to send() are copied
+			// on the calling thread, so their bodies live where that thread
+			// allocates. The thread that calls update() can be pinned
+			// with pin_current_thread()
+			void set_io_core(int core)
+			{
+				m_nIOCore = core;
+			}
+
+			// Applied to every new connection
+			void set_max_message_size(uint64_t size)
+			{
+				m_nMaxMessageSize = size;
+			}
+
+			// Records traffic of connections accepted after that call,
+			// capture must outlive them
+			void set_capture(capture<T>* cap)
+			{
+				m_pCapture = cap;
+			}
+
+			// Messages waiting for update(), replay() can feed a capture here
+			ts_deque<owned_message<T>>& incoming()
+			{
+				return m_tsqMessagesIn;
+			}
+
+#ifdef ASIO_HAS_CO_AWAIT
+			// Every validated client gets its own OnSession() coroutine
+			// that reads messages directly instead of the incoming queue
+			void use_sessions(bool enable = true)
+			{
+				m_bSessions = enable;
+			}
+#endif
+
 		public:
 			// User must call that to update state
 			void update(size_t max = -1, bool wait = false)
 			{
-				// Store amount of messages
-				size_t messages_count = 0;
-				
-				// While there are any messages and the message count is still good
-				while (messages_count < max && !m_tsqMessagesIn.empty())
-				{
-					// Get message
-					owned_message<T> msg = m_tsqMessagesIn.pop_front();
-
+				// Sleep until something arrives
+				// instead of spinning on an empty queue
+				if (wait)
+					m_tsqMessagesIn.wait();
+
+				// Take all messages (but not more than max)
+				// with a single lock, so the I/O thread isn't blocked
+				// while we handle them
+				m_vecDispatch.clear();
+				m_tsqMessagesIn.drain_into(m_vecDispatch, max);
+
+				for (auto& msg : m_vecDispatch)
 					OnMessage(msg.remote, msg.msg);
 
-					messages_count++;
-				}
+				m_vecDispatch.clear();
 			}
 
 			// Called when a client connects
-			virtual bool OnClientConnect(std::shared_ptr<connection<T>> client)
+			virtual bool OnClientConnect(std::shared_ptr<connection<T>> /*client*/)
 			{
 				return false;
 			}
 
 			// Called when a client disconnects
-			virtual void OnClientDisconnect(std::shared_ptr<connection<T>> client)
+			virtual void OnClientDisconnect(std::shared_ptr<connection<T>> /*client*/)
 			{
 				
 			}
 			
-			virtual void OnClientValidated(std::shared_ptr<connection<T>> client)
+			virtual void OnClientValidated(std::shared_ptr<connection<T>> /*client*/)
 			{
 				
 			}
 
-			// Called when a message arrives
-			virtual void OnMessage(std::shared_ptr<connection<T>> client, message<T>& msg)
+			// Called when a message arrives, client is nullptr
+			// for messages pushed by replay() without a remote
+			virtual void OnMessage(std::shared_ptr<connection<T>> /*client*/, message<T>& /*msg*/)
 			{
 				
 			}
 
+#ifdef ASIO_HAS_CO_AWAIT
+			// Runs on the I/O thread for every client when sessions are used,
+			// the client is disconnected when it returns
+			virtual asio::awaitable<void> OnSession(std::shared_ptr<connection<T>> /*client*/)
+			{
+				co_return;
+			}
+#endif
+
+			// Called from the I/O thread when a part of a streamed body arrives,
+			// so it must be quick and can't keep chunk.data after return
+			virtual void OnStreamChunk(std::shared_ptr<connection<T>> /*client*/, const stream_chunk<T>& /*chunk*/)
+			{
+
+			}
+
 		private:
 			// Incoming messages
 			ts_deque<owned_message<T>> m_tsqMessagesIn;
 
+			// Batch of messages taken by update(), kept
+			// between calls so it doesn't allocate every time
+			std::vector<owned_message<T>> m_vecDispatch;
+
 			// Will store all connections
 			std::deque<std::shared_ptr<connection<T>>> m_deqConnections;
 
@@ -259,6 +364,17 @@ namespace def
 
 			// All IDs will start from this number
 			uint32_t m_nIDCounter = 10000;
+
+			uint64_t m_nMaxMessageSize = 64 * 1024 * 1024;
+
+			capture<T>* m_pCapture = nullptr;
+
+			// Core for the I/O thread, -1 lets the scheduler decide
+			int m_nIOCore = -1;
+
+#ifdef ASIO_HAS_CO_AWAIT
+			bool m_bSessions = false;
+#endif
 		};
 	}
 }
@@ -63,24 +63,70 @@ namespace def
 
 			void push_back(const T& value)
 			{
-				std::scoped_lock lock(muxQueue);
-				deqQueue.emplace_back(std::move(value));
+				{
+					std::scoped_lock lock(muxQueue);
+					deqQueue.push_back(value);
+				}
+
+				// signal std::condition_variable to wake up thread,
+				// it's done without the lock so the waiter
+				// doesn't wake up just to block on it again
+				cvWaiting.notify_one();
+			}
+
+			void push_back(T&& value)
+			{
+				{
+					std::scoped_lock lock(muxQueue);
+					deqQueue.push_back(std::move(value));
+				}
 
-				// signal std::condition_variable to wake up thread
-				std::unique_lock<std::mutex> ul(muxWaiting);
 				cvWaiting.notify_one();
 			}
 
 			void push_front(const T& value)
 			{
-				std::scoped_lock lock(muxQueue);
-				deqQueue.emplace_front(std::move(value));
+				{
+					std::scoped_lock lock(muxQueue);
+					deqQueue.push_front(value);
+				}
+
+				cvWaiting.notify_one();
+			}
+
+			void push_front(T&& value)
+			{
+				{
+					std::scoped_lock lock(muxQueue);
+					deqQueue.push_front(std::move(value));
+				}
 
-				// signal std::condition_variable to wake up thread
-				std::unique_lock<std::mutex> ul(muxWaiting);
 				cvWaiting.notify_one();
 			}
 
+			// Pushes the whole range under a single lock
+			template <typename Iterator>
+			void push_range(Iterator first, Iterator last)
+			{
+				if (first == last)
+					return;
+
+				{
+					std::scoped_lock lock(muxQueue);
+					deqQueue.insert(deqQueue.end(), first, last);
+				}
+
+				cvWaiting.notify_all();
+			}
+
+			// Moves elements of the container in, the container keeps
+			// moved-from elements so it's up to caller to clear it
+			template <typename Container>
+			void push_range(Container& container)
+			{
+				push_range(std::make_move_iterator(container.begin()), std::make_move_iterator(container.end()));
+			}
+
 			bool empty()
 			{
 				std::scoped_lock lock(muxQueue);
@@ -115,19 +161,61 @@ namespace def
 				return t;
 			}
 
+			// Same as pop_front() but doesn't
+			// need a separate empty() check
+			std::optional<T> try_pop()
+			{
+				std::scoped_lock lock(muxQueue);
+
+				if (deqQueue.empty())
+					return std::nullopt;
+
+				std::optional<T> t(std::move(deqQueue.front()));
+				deqQueue.pop_front();
+				return t;
+			}
+
+			// Moves up to max elements from the front to the back
+			// of the container under a single lock, returns their amount
+			template <typename Container>
+			size_t drain_into(Container& container, size_t max = size_t(-1))
+			{
+				std::scoped_lock lock(muxQueue);
+
+				size_t count = std::min(max, deqQueue.size());
+
+				auto end = deqQueue.begin() + count;
+				std::move(deqQueue.begin(), end, std::back_inserter(container));
+				deqQueue.erase(deqQueue.begin(), end);
+
+				return count;
+			}
+
 			void wait()
 			{
-				// while there are no signals
+				// while there are no elements
 				// we "freeze" the thread
+				std::unique_lock<std::mutex> ul(muxQueue);
+				cvWaiting.wait(ul, [this]() { return !deqQueue.empty(); });
+			}
 
-				// there could be some errors,
-				// but it doesn't really matter
-				
-				while (empty())
-				{
-					std::unique_lock<std::mutex> ul(muxWaiting);
-					cvWaiting.wait(ul);
-				}
+			// Returns false if nothing arrived in time
+			template <typename Rep, typename Period>
+			bool wait_for(const std::chrono::duration<Rep, Period>& timeout)
+			{
+				std::unique_lock<std::mutex> ul(muxQueue);
+				return cvWaiting.wait_for(ul, timeout, [this]() { return !deqQueue.empty(); });
+			}
+
+			// Blocks until there is an element and takes it
+			T wait_pop()
+			{
+				std::unique_lock<std::mutex> ul(muxQueue);
+				cvWaiting.wait(ul, [this]() { return !deqQueue.empty(); });
+
+				auto t = std::move(deqQueue.front());
+				deqQueue.pop_front();
+				return t;
 			}
 
 		private:
@@ -135,7 +223,6 @@ namespace def
 			std::deque<T> deqQueue;
 
 			std::condition_variable cvWaiting;
-			std::mutex muxWaiting;
 		};
 	}
 }
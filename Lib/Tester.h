@@ -36,14 +36,23 @@
 #include <thread>
 #include <iostream>
 
+#include "ThreadPool.h"
+
 #pragma endregion
 
+// GCC has no __builtin_COLUMN
+#if defined(__clang__) || defined(_MSC_VER)
+#define SFL_BUILTIN_COLUMN __builtin_COLUMN()
+#else
+#define SFL_BUILTIN_COLUMN 0
+#endif
+
 namespace sfl
 {
 	struct SourceLoc
 	{
 		SourceLoc(const uint32_t nLine = __builtin_LINE(),
-			const uint32_t nColumn = __builtin_COLUMN(), const char* const sFile = __builtin_FILE(),
+			const uint32_t nColumn = SFL_BUILTIN_COLUMN, const char* const sFile = __builtin_FILE(),
 			const char* const sFunction = __builtin_FUNCTION())
 		{
 			m_nLine = nLine;
@@ -76,7 +85,7 @@ namespace sfl
 		std::string sFailNote;
 	};
 
-	bool Assert(bool bExpr, std::string sMsg = "undefined", SourceLoc sl = SourceLoc())
+	inline bool Assert(bool bExpr, std::string sMsg = "undefined", SourceLoc sl = SourceLoc())
 	{
 		if (!bExpr)
 		{
@@ -96,6 +105,9 @@ namespace sfl
 		{
 			if (m_tTestThread.joinable())
 				m_tTestThread.join();
+
+			if (m_thTests.Valid())
+				m_thTests.Wait();
 		}
 
 	private:
@@ -103,11 +115,18 @@ namespace sfl
 
 		std::thread m_tTestThread;
 
+		// If it's set then tests run as a task of that pool
+		// instead of their own thread
+		ThreadPool* m_pThreadPool = nullptr;
+		TaskHandle<void> m_thTests;
+
 		bool m_bAlsoRunIgnored = false;
 		bool m_bOnlyRunIgnored = false;
 
 		std::string m_sFilter;
 
+		bool m_bResult = false;
+
 	public:
 		void AddTest(bool (*fTest)(void), std::string sName, bool bIgnored = false, bool bMeasured = false, bool bShouldPanic = false, std::string sFailNote = "")
 		{
@@ -130,7 +149,28 @@ namespace sfl
 
 			m_sFilter = sFilter;
 
-			m_tTestThread = std::thread(&Tester::TestThread, this);
+			if (m_pThreadPool)
+				m_thTests = m_pThreadPool->Submit([this]() { TestThread(); });
+			else
+				m_tTestThread = std::thread(&Tester::TestThread, this);
+		}
+
+		void SetThreadPool(ThreadPool* pPool)
+		{
+			m_pThreadPool = pPool;
+		}
+
+		// Waits for the tests started by StartTests,
+		// returns true if none of them has failed
+		bool WaitTests()
+		{
+			if (m_tTestThread.joinable())
+				m_tTestThread.join();
+
+			if (m_thTests.Valid())
+				m_thTests.Wait();
+
+			return m_bResult;
 		}
 
 	private:
@@ -218,6 +258,7 @@ namespace sfl
 				fSecondsTook = 0.0f;
 
 			bool bTestResult = (nFailed == 0);
+			m_bResult = bTestResult;
 
 			std::cout << "test result: " << std::boolalpha << bTestResult << ". " <<
 				nPassed << " passed; " << nFailed << " failed; " << nIgnored << " ignored; " <<
@@ -0,0 +1,582 @@
+#pragma once
+
+#pragma region license
+/***
+*	BSD 3-Clause License
+	Copyright (c) 2021, 2022 Alex
+	All rights reserved.
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+***/
+#pragma endregion
+
+#pragma region includes
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+
+#pragma endregion
+
+namespace sfl
+{
+	class ThreadPool;
+
+	namespace detail
+	{
+		struct Task
+		{
+			std::function<void()> fTask;
+		};
+
+		// Chase-Lev deque: the owner pushes and pops at the bottom
+		// without locks, other workers steal from the top
+		class WorkStealingDeque
+		{
+		public:
+			WorkStealingDeque()
+			{
+				m_vecArrays.push_back(std::make_unique<Array>(64));
+				m_aArray.store(m_vecArrays.back().get(), std::memory_order_relaxed);
+			}
+
+			WorkStealingDeque(const WorkStealingDeque&) = delete;
+
+		public:
+			// Only the owner can call that
+			void Push(Task* pTask)
+			{
+				int64_t b = m_nBottom.load(std::memory_order_relaxed);
+				int64_t t = m_nTop.load(std::memory_order_acquire);
+				Array* pArray = m_aArray.load(std::memory_order_relaxed);
+
+				if (b - t > pArray->nCapacity - 1)
+				{
+					// It's full so make it twice bigger, old arrays are kept
+					// until the deque dies since thieves could still read them
+					m_vecArrays.push_back(pArray->Grow(b, t));
+					pArray = m_vecArrays.back().get();
+					m_aArray.store(pArray, std::memory_order_release);
+				}
+
+				pArray->Put(b, pTask);
+
+				std::atomic_thread_fence(std::memory_order_release);
+				m_nBottom.store(b + 1, std::memory_order_relaxed);
+			}
+
+			// Only the owner can call that
+			Task* Pop()
+			{
+				int64_t b = m_nBottom.load(std::memory_order_relaxed) - 1;
+				Array* pArray = m_aArray.load(std::memory_order_relaxed);
+				m_nBottom.store(b, std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = m_nTop.load(std::memory_order_relaxed);
+
+				if (t > b)
+				{
+					// Deque was empty
+					m_nBottom.store(b + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+
+				Task* pTask = pArray->Get(b);
+
+				if (t == b)
+				{
+					// That's the last one, so we race with thieves for it
+					if (!m_nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						pTask = nullptr;
+
+					m_nBottom.store(b + 1, std::memory_order_relaxed);
+				}
+
+				return pTask;
+			}
+
+			// Any thread can call that
+			Task* Steal()
+			{
+				int64_t t = m_nTop.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t b = m_nBottom.load(std::memory_order_acquire);
+
+				if (t >= b)
+					return nullptr;
+
+				Array* pArray = m_aArray.load(std::memory_order_acquire);
+				Task* pTask = pArray->Get(t);
+
+				if (!m_nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					return nullptr;
+
+				return pTask;
+			}
+
+		private:
+			struct Array
+			{
+				Array(int64_t capacity) : nCapacity(capacity), vecBuffer(size_t(capacity)) {}
+
+				int64_t nCapacity;
+				std::vector<std::atomic<Task*>> vecBuffer;
+
+				Task* Get(int64_t i)
+				{
+					return vecBuffer[size_t(i & (nCapacity - 1))].load(std::memory_order_acquire);
+				}
+
+				void Put(int64_t i, Task* pTask)
+				{
+					vecBuffer[size_t(i & (nCapacity - 1))].store(pTask, std::memory_order_release);
+				}
+
+				std::unique_ptr<Array> Grow(int64_t b, int64_t t)
+				{
+					auto pArray = std::make_unique<Array>(nCapacity * 2);
+
+					for (int64_t i = t; i < b; i++)
+						pArray->Put(i, Get(i));
+
+					return pArray;
+				}
+			};
+
+			alignas(64) std::atomic<int64_t> m_nTop{ 0 };
+			alignas(64) std::atomic<int64_t> m_nBottom{ 0 };
+			alignas(64) std::atomic<Array*> m_aArray{ nullptr };
+
+			std::vector<std::unique_ptr<Array>> m_vecArrays;
+		};
+	}
+
+	// Counts tasks that were submitted into it,
+	// so it's possible to wait for all of them at once
+	class TaskGroup
+	{
+	public:
+		TaskGroup(ThreadPool& pool) : m_pool(pool) {}
+
+		TaskGroup(const TaskGroup&) = delete;
+
+		~TaskGroup();
+
+	public:
+		template <typename F>
+		void Run(F&& fTask);
+
+		// Runs other tasks while waiting, so it's safe
+		// to call it from inside of a task. If any task threw,
+		// the first exception is rethrown here
+		void Wait();
+
+		bool Done() const
+		{
+			return m_nPending.load(std::memory_order_acquire) == 0;
+		}
+
+	private:
+		ThreadPool& m_pool;
+		std::atomic<size_t> m_nPending{ 0 };
+
+		std::mutex m_muxError;
+		std::exception_ptr m_pError;
+
+	};
+
+	template <typename R>
+	class TaskHandle
+	{
+	public:
+		TaskHandle() = default;
+		TaskHandle(ThreadPool* pPool, std::future<R> future) : m_pPool(pPool), m_future(std::move(future)) {}
+
+	public:
+		bool Valid() const
+		{
+			return m_future.valid();
+		}
+
+		bool Ready() const
+		{
+			return m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		// Runs other tasks while waiting
+		void Wait();
+
+		R Get()
+		{
+			Wait();
+			return m_future.get();
+		}
+
+	private:
+		ThreadPool* m_pPool = nullptr;
+		std::future<R> m_future;
+
+	};
+
+	class ThreadPool
+	{
+	public:
+		ThreadPool(size_t nThreads = std::max(1u, std::thread::hardware_concurrency()))
+		{
+			nThreads = std::max<size_t>(nThreads, 1);
+
+			for (size_t i = 0; i < nThreads; i++)
+				m_vecWorkers.push_back(std::make_unique<Worker>());
+
+			for (size_t i = 0; i < nThreads; i++)
+				m_vecWorkers[i]->tThread = std::thread(&ThreadPool::WorkerThread, this, i);
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_muxSleep);
+				m_bStop = true;
+			}
+
+			m_cvSleep.notify_all();
+
+			for (auto& worker : m_vecWorkers)
+				worker->tThread.join();
+
+			// Tasks that nobody ran
+			while (detail::Task* pTask = TakeInjected())
+				delete pTask;
+
+			for (auto& worker : m_vecWorkers)
+			{
+				while (detail::Task* pTask = worker->deqTasks.Pop())
+					delete pTask;
+			}
+		}
+
+	public:
+		// Pool for everyone who doesn't want to create their own
+		static ThreadPool& Default()
+		{
+			static ThreadPool pool;
+			return pool;
+		}
+
+		size_t ThreadCount() const
+		{
+			return m_vecWorkers.size();
+		}
+
+		template <typename F>
+		auto Submit(F&& fTask) -> TaskHandle<decltype(fTask())>
+		{
+			using R = decltype(fTask());
+
+			auto pPackaged = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fTask));
+			std::future<R> future = pPackaged->get_future();
+
+			Enqueue([pPackaged]() { (*pPackaged)(); });
+
+			return TaskHandle<R>(this, std::move(future));
+		}
+
+		// Calls fBody(i) for every i in [nBegin, nEnd),
+		// nGrain indices per task (0 picks it by itself)
+		template <typename F>
+		void ParallelFor(size_t nBegin, size_t nEnd, F&& fBody, size_t nGrain = 0)
+		{
+			if (nBegin >= nEnd)
+				return;
+
+			size_t nCount = nEnd - nBegin;
+
+			if (nGrain == 0)
+				nGrain = std::max<size_t>(1, nCount / (ThreadCount() * 8));
+
+			TaskGroup group(*this);
+
+			for (size_t i = nBegin; i < nEnd; i += nGrain)
+			{
+				size_t nTo = std::min(i + nGrain, nEnd);
+
+				group.Run(
+					[&fBody, i, nTo]()
+					{
+						for (size_t j = i; j < nTo; j++)
+							fBody(j);
+					}
+				);
+			}
+
+			group.Wait();
+		}
+
+		// Takes one queued task and runs it on the calling thread,
+		// returns false if there was nothing to do
+		bool RunPendingTask()
+		{
+			detail::Task* pTask = nullptr;
+
+			if (CurrentPool() == this)
+				pTask = m_vecWorkers[CurrentIndex()]->deqTasks.Pop();
+
+			if (!pTask)
+				pTask = StealAny(CurrentPool() == this ? CurrentIndex() : 0);
+
+			if (!pTask)
+				pTask = TakeInjected();
+
+			if (!pTask)
+				return false;
+
+			Execute(pTask);
+			return true;
+		}
+
+	private:
+		friend class TaskGroup;
+
+		struct Worker
+		{
+			detail::WorkStealingDeque deqTasks;
+			std::thread tThread;
+		};
+
+		static ThreadPool*& CurrentPool()
+		{
+			static thread_local ThreadPool* pPool = nullptr;
+			return pPool;
+		}
+
+		static size_t& CurrentIndex()
+		{
+			static thread_local size_t nIndex = 0;
+			return nIndex;
+		}
+
+		void Enqueue(std::function<void()> fTask)
+		{
+			detail::Task* pTask = new detail::Task{ std::move(fTask) };
+
+			m_nQueued.fetch_add(1, std::memory_order_seq_cst);
+
+			if (CurrentPool() == this)
+			{
+				// Workers keep their tasks to themselves
+				// until somebody steals them
+				m_vecWorkers[CurrentIndex()]->deqTasks.Push(pTask);
+			}
+			else
+			{
+				std::scoped_lock lock(m_muxInjected);
+				m_deqInjected.push_back(pTask);
+			}
+
+			if (m_nSleeping.load(std::memory_order_seq_cst) > 0)
+			{
+				// Lock makes sure a worker can't miss the notification
+				// between checking the queue and going to sleep
+				{ std::scoped_lock lock(m_muxSleep); }
+				m_cvSleep.notify_one();
+			}
+		}
+
+		detail::Task* TakeInjected()
+		{
+			std::scoped_lock lock(m_muxInjected);
+
+			if (m_deqInjected.empty())
+				return nullptr;
+
+			detail::Task* pTask = m_deqInjected.front();
+			m_deqInjected.pop_front();
+			return pTask;
+		}
+
+		detail::Task* StealAny(size_t nSelf)
+		{
+			size_t nCount = m_vecWorkers.size();
+
+			// Start from a random victim so thieves don't all
+			// hammer the same deque
+			static thread_local std::minstd_rand rng(std::random_device{}());
+			size_t nStart = rng() % nCount;
+
+			for (size_t i = 0; i < nCount; i++)
+			{
+				size_t nVictim = (nStart + i) % nCount;
+
+				if (nVictim == nSelf && CurrentPool() == this)
+					continue;
+
+				if (detail::Task* pTask = m_vecWorkers[nVictim]->deqTasks.Steal())
+					return pTask;
+			}
+
+			return nullptr;
+		}
+
+		void Execute(detail::Task* pTask)
+		{
+			m_nQueued.fetch_sub(1, std::memory_order_relaxed);
+
+			pTask->fTask();
+			delete pTask;
+		}
+
+		void WorkerThread(size_t nIndex)
+		{
+			CurrentPool() = this;
+			CurrentIndex() = nIndex;
+
+			while (true)
+			{
+				// Spin a little before going to sleep,
+				// new tasks often come in bursts
+				bool bFound = false;
+
+				for (int i = 0; i < 64 && !bFound; i++)
+				{
+					bFound = RunPendingTask();
+
+					if (!bFound)
+						std::this_thread::yield();
+				}
+
+				if (bFound)
+					continue;
+
+				std::unique_lock<std::mutex> lock(m_muxSleep);
+
+				if (m_bStop)
+					break;
+
+				m_nSleeping.fetch_add(1, std::memory_order_seq_cst);
+
+				m_cvSleep.wait(lock, [this]()
+				{
+					return m_bStop || m_nQueued.load(std::memory_order_seq_cst) > 0;
+				});
+
+				m_nSleeping.fetch_sub(1, std::memory_order_relaxed);
+
+				if (m_bStop)
+					break;
+			}
+
+			CurrentPool() = nullptr;
+		}
+
+	private:
+		std::vector<std::unique_ptr<Worker>> m_vecWorkers;
+
+		// Tasks submitted by threads that aren't workers
+		std::mutex m_muxInjected;
+		std::deque<detail::Task*> m_deqInjected;
+
+		// Tasks that were submitted but haven't started yet
+		std::atomic<size_t> m_nQueued{ 0 };
+		std::atomic<size_t> m_nSleeping{ 0 };
+
+		std::mutex m_muxSleep;
+		std::condition_variable m_cvSleep;
+		bool m_bStop = false;
+
+	};
+
+	template <typename F>
+	void TaskGroup::Run(F&& fTask)
+	{
+		m_nPending.fetch_add(1, std::memory_order_relaxed);
+
+		m_pool.Enqueue(
+			[this, fTask = std::forward<F>(fTask)]() mutable
+			{
+				try
+				{
+					fTask();
+				}
+				catch (...)
+				{
+					std::scoped_lock lock(m_muxError);
+
+					if (!m_pError)
+						m_pError = std::current_exception();
+				}
+
+				m_nPending.fetch_sub(1, std::memory_order_release);
+			}
+		);
+	}
+
+	inline TaskGroup::~TaskGroup()
+	{
+		// Tasks reference the group, so it can't die before them
+		while (!Done())
+		{
+			if (!m_pool.RunPendingTask())
+				std::this_thread::yield();
+		}
+	}
+
+	inline void TaskGroup::Wait()
+	{
+		while (!Done())
+		{
+			if (!m_pool.RunPendingTask())
+				std::this_thread::yield();
+		}
+
+		std::exception_ptr pError;
+
+		{
+			std::scoped_lock lock(m_muxError);
+			std::swap(pError, m_pError);
+		}
+
+		if (pError)
+			std::rethrow_exception(pError);
+	}
+
+	template <typename R>
+	void TaskHandle<R>::Wait()
+	{
+		while (!Ready())
+		{
+			if (!m_pPool || !m_pPool->RunPendingTask())
+				std::this_thread::yield();
+		}
+	}
+}
@@ -36,6 +36,10 @@
 #include "Lib/Flag.h"
 #endif
 
+#ifdef SFL_THREADPOOL
+#include "Lib/ThreadPool.h"
+#endif
+
 #ifdef SFL_TESTER
 #include "Lib/Tester.h"
 #endif
@@ -44,6 +48,10 @@
 #include "Lib/DataFile.h"
 #endif
 
+#ifdef SFL_DATAFILEWATCHER
+#include "Lib/DataFileWatcher.h"
+#endif
+
 #ifdef SFL_NET
 #include "Lib/Net/Net.h"
 #endif
@@ -52,6 +60,10 @@
 #include "Lib/CsvReader.h"
 #endif
 
+#ifdef SFL_CSVWRITER
+#include "Lib/CsvWriter.h"
+#endif
+
 #ifdef SFL_VEC2D
 #include "Lib/Vec2D.h"
 #endif
@@ -71,3 +83,7 @@
 #ifdef SFL_MENU
 #include "Lib/Menu.h"
 #endif
+
+#ifdef SFL_MAPPEDFILE
+#include "Lib/MappedFile.h"
+#endif
@@ -0,0 +1,271 @@
+#define SFL_CSVREADER
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <iostream>
+#include <fstream>
+
+// Cells of both readers are compared one by one
+bool SameCells(const sfl::CsvReader& a, const sfl::CsvReader& b)
+{
+	if (a.GetTotalRows() != b.GetTotalRows() || a.GetTotalCols() != b.GetTotalCols())
+		return false;
+
+	for (int i = 0; i < a.GetTotalRows(); i++)
+	{
+		if (a.GetRowSize(i) != b.GetRowSize(i))
+			return false;
+
+		for (int j = 0; j < (int)a.GetRowSize(i); j++)
+		{
+			if (a.GetValue(i, j) != b.GetValue(i, j))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool LoadBoth(const std::string& sFileName, const sfl::CsvDialect& dialect)
+{
+	sfl::ThreadPool pool(4);
+
+	sfl::CsvReader readerLoad, readerParallel;
+
+	readerLoad.SetFileName(sFileName);
+	readerLoad.SetDialect(dialect);
+
+	readerParallel.SetFileName(sFileName);
+	readerParallel.SetDialect(dialect);
+
+	if (!readerLoad.Load() || !readerParallel.LoadParallel(pool))
+		return false;
+
+	return SameCells(readerLoad, readerParallel);
+}
+
+// A quote that isn't at the start of a value is a part of it,
+// the split used to count it and cut inside a later quoted value
+bool LoadParallelStrayQuotes()
+{
+	{
+		std::ofstream file("reader_test.csv", std::ios::binary);
+
+		for (int i = 0; i < 20000; i++)
+		{
+			if (i % 7 == 0)
+				file << i << ",12\",inch\n";
+			else if (i % 7 == 3)
+				file << i << ",\"two\nlines, \"\"quoted\"\"\",x\n";
+			else
+				file << i << ",plain,\"a\"b\"\n";
+		}
+	}
+
+	bool bPassed = LoadBoth("reader_test.csv", sfl::CsvDialect());
+
+	std::remove("reader_test.csv");
+
+	return bPassed;
+}
+
+// Same with blanks before quotes and an escape that isn't the quote
+bool LoadParallelTrimAndEscape()
+{
+	{
+		std::ofstream file("reader_test.csv", std::ios::binary);
+
+		for (int i = 0; i < 20000; i++)
+		{
+			if (i % 5 == 0)
+				file << i << ",  \"new\nline \\\" here\",5\"\n";
+			else
+				file << i << ",x \"y,\"z\"\n";
+		}
+	}
+
+	sfl::CsvDialect dialect;
+	dialect.cEscape = '\\';
+	dialect.trim = sfl::CsvDialect::Trim::Unquoted;
+
+	bool bPassed = LoadBoth("reader_test.csv", dialect);
+
+	std::remove("reader_test.csv");
+
+	return bPassed;
+}
+
+// Loads the text into Storage::Columns
+bool LoadColumns(sfl::CsvReader& reader, const std::string& sText, std::vector<sfl::CsvReader::Column::Type> vecSchema = {})
+{
+	{
+		std::ofstream file("reader_test.csv", std::ios::binary);
+		file << sText;
+	}
+
+	reader.SetFileName("reader_test.csv");
+	reader.SetStorage(sfl::CsvReader::Storage::Columns);
+	reader.SetSchema(std::move(vecSchema));
+
+	bool bLoaded = reader.Load();
+	std::remove("reader_test.csv");
+
+	return bLoaded;
+}
+
+// Zip codes used to become numbers and lose their zeros
+bool InferLeadingZeros()
+{
+	sfl::CsvReader reader;
+
+	if (!LoadColumns(reader, "00501,0,-0.5\n10001,7,0.25\n"))
+		return false;
+
+	return reader.GetColumn(0).GetType() == sfl::CsvReader::Column::Type::String &&
+		reader.GetView(0, 0) == "00501" && reader.GetValue(0, 0) == "00501" &&
+		reader.GetColumn(1).GetType() == sfl::CsvReader::Column::Type::Int &&
+		reader.GetColumn(2).GetType() == sfl::CsvReader::Column::Type::Double;
+}
+
+// Found types keep the text numbers don't give back, a schema type doesn't
+bool InferKeepsText()
+{
+	sfl::CsvReader reader;
+
+	if (!LoadColumns(reader, "1.50,1e3\n2,\n"))
+		return false;
+
+	const auto& column = reader.GetColumn(0);
+
+	if (column.GetType() != sfl::CsvReader::Column::Type::Double || column.Double(0) != 1.5)
+		return false;
+
+	// Typed columns have no views, the text comes from GetValue
+	if (!reader.GetView(0, 0).empty() || reader.GetValue(0, 0) != "1.50" || reader.GetValue(1, 0) != "2" || reader.GetValue(0, 1) != "1e3")
+		return false;
+
+	if (!reader.GetColumn(1).IsNull(1) || reader.GetValue(1, 1) != "")
+		return false;
+
+	sfl::CsvReader readerSchema;
+
+	if (!LoadColumns(readerSchema, "1.50,1e3\n2,\n", { sfl::CsvReader::Column::Type::Double }))
+		return false;
+
+	return readerSchema.GetView(0, 0).empty() && readerSchema.GetValue(0, 0) == "1.5" && readerSchema.GetValue(0, 1) == "1e3";
+}
+
+// nan and inf are only numbers if the schema says so
+bool InferNanInf()
+{
+	sfl::CsvReader reader;
+
+	if (!LoadColumns(reader, "nan,1\ninf,2\n"))
+		return false;
+
+	if (reader.GetColumn(0).GetType() != sfl::CsvReader::Column::Type::String || reader.GetValue(1, 0) != "inf")
+		return false;
+
+	sfl::CsvReader readerSchema;
+
+	if (!LoadColumns(readerSchema, "nan,1\ninf,2\n", { sfl::CsvReader::Column::Type::Double }))
+		return false;
+
+	const auto& column = readerSchema.GetColumn(0);
+
+	return column.GetType() == sfl::CsvReader::Column::Type::Double &&
+		std::isnan(column.Double(0)) && std::isinf(column.Double(1)) && column.ErrorCount() == 0;
+}
+
+// Loads the text with both storages and checks every cell
+bool ExpectRows(const std::string& sText, const std::vector<std::vector<std::string>>& vecRows)
+{
+	{
+		std::ofstream file("reader_test.csv", std::ios::binary);
+		file << sText;
+	}
+
+	bool bPassed = true;
+
+	for (auto storage : { sfl::CsvReader::Storage::Rows, sfl::CsvReader::Storage::Columns })
+	{
+		sfl::CsvReader reader;
+		reader.SetFileName("reader_test.csv");
+		reader.SetStorage(storage);
+
+		if (!reader.Load() || reader.GetTotalRows() != (int)vecRows.size())
+		{
+			bPassed = false;
+			break;
+		}
+
+		for (size_t i = 0; i < vecRows.size(); i++)
+		{
+			// Columns keep every row as wide as the widest one
+			if (storage == sfl::CsvReader::Storage::Rows && reader.GetRowSize(i) != vecRows[i].size())
+				bPassed = false;
+
+			for (size_t j = 0; j < vecRows[i].size(); j++)
+			{
+				if (reader.GetValue((int)i, (int)j) != vecRows[i][j])
+					bPassed = false;
+			}
+		}
+	}
+
+	std::remove("reader_test.csv");
+
+	return bPassed;
+}
+
+bool QuotedDelimiter()
+{
+	return ExpectRows("a,\"b,c\"\n", { { "a", "b,c" } });
+}
+
+bool DoubledQuotes()
+{
+	return ExpectRows("\"say \"\"hi\"\"\",x\n", { { "say \"hi\"", "x" } });
+}
+
+bool CRLF()
+{
+	return ExpectRows("a,b\r\nc,\"d\"\r\n", { { "a", "b" }, { "c", "d" } });
+}
+
+bool TrailingEmptyField()
+{
+	return ExpectRows("a,b,\nc,d,e\n", { { "a", "b", "" }, { "c", "d", "e" } });
+}
+
+bool QuotedNewLine()
+{
+	return ExpectRows("\"x\ny\",z\nw,v", { { "x\ny", "z" }, { "w", "v" } });
+}
+
+// Empty line is a row without values
+bool EmptyLine()
+{
+	return ExpectRows("a\n\nb\n", { { "a" }, {}, { "b" } });
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(QuotedDelimiter, "QuotedDelimiter");
+	tester.AddTest(DoubledQuotes, "DoubledQuotes");
+	tester.AddTest(CRLF, "CRLF");
+	tester.AddTest(TrailingEmptyField, "TrailingEmptyField");
+	tester.AddTest(QuotedNewLine, "QuotedNewLine");
+	tester.AddTest(EmptyLine, "EmptyLine");
+	tester.AddTest(LoadParallelStrayQuotes, "LoadParallelStrayQuotes");
+	tester.AddTest(LoadParallelTrimAndEscape, "LoadParallelTrimAndEscape");
+	tester.AddTest(InferLeadingZeros, "InferLeadingZeros");
+	tester.AddTest(InferKeepsText, "InferKeepsText");
+	tester.AddTest(InferNanInf, "InferNanInf");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#define SFL_CSVWRITER
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+template <typename T, typename = void>
+struct CanWrite : std::false_type {};
+
+template <typename T>
+struct CanWrite<T, std::void_t<decltype(std::declval<sfl::CsvWriter&>().Write(std::declval<T>()))>> : std::true_type {};
+
+// Wide characters can't be written as text, so they aren't taken as numbers either
+static_assert(!CanWrite<wchar_t>::value && !CanWrite<char32_t>::value);
+static_assert(CanWrite<char>::value && CanWrite<int8_t>::value);
+
+std::string ReadText(const std::string& sFileName)
+{
+	std::ifstream file(sFileName, std::ios::binary);
+	std::stringstream ss;
+	ss << file.rdbuf();
+
+	return ss.str();
+}
+
+// char used to be written as its code
+bool WriteChar()
+{
+	sfl::CsvWriter writer;
+
+	if (!writer.Open("writer_test.csv"))
+		return false;
+
+	writer.WriteRow('x', (int8_t)5, ',');
+
+	bool bPassed = writer.Close() && ReadText("writer_test.csv") == "x,5,\",\"\n";
+
+	std::remove("writer_test.csv");
+
+	return bPassed;
+}
+
+// Blanks around values used to be lost by a reader that trims
+bool WriteBlanksRoundTrip()
+{
+	std::vector<std::string> vecValues = { " a", "b ", "\tc\t", "d e" };
+
+	sfl::CsvWriter writer;
+
+	if (!writer.Open("writer_test.csv"))
+		return false;
+
+	writer.WriteRange(vecValues);
+
+	if (!writer.Close())
+		return false;
+
+	sfl::CsvDialect dialect;
+	dialect.trim = sfl::CsvDialect::Trim::Unquoted;
+
+	sfl::CsvReader reader;
+	reader.SetFileName("writer_test.csv");
+	reader.SetDialect(dialect);
+
+	bool bPassed = reader.Load() && reader.GetRowSize(0) == vecValues.size();
+
+	for (size_t i = 0; bPassed && i < vecValues.size(); i++)
+		bPassed = reader.GetValue(0, (int)i) == vecValues[i];
+
+	std::remove("writer_test.csv");
+
+	return bPassed;
+}
+
+// Without quotes delimiters and new lines used to be written as they are
+bool WriteNoQuotesRejects()
+{
+	sfl::CsvDialect dialect;
+	dialect.cQuote = 0;
+
+	sfl::CsvWriter writer;
+	writer.SetDialect(dialect);
+
+	if (!writer.Open("writer_test.csv"))
+		return false;
+
+	writer.WriteRow(1, "a,b", "c\nd", "e\rf", " g ");
+
+	bool bClosed = writer.Close();
+	bool bPassed = !bClosed && ReadText("writer_test.csv") == "1,,,, g \n";
+
+	// Values that can be written are still fine
+	if (!writer.Open("writer_test.csv"))
+		return false;
+
+	writer.WriteRow(1, "a\"b");
+
+	bPassed = bPassed && writer.Close() && ReadText("writer_test.csv") == "1,a\"b\n";
+
+	std::remove("writer_test.csv");
+
+	return bPassed;
+}
+
+// Null alone in a row used to be written as an empty line,
+// which is read as a row without values
+bool WriteNullRoundTrip()
+{
+	sfl::CsvWriter writer;
+
+	if (!writer.Open("writer_test.csv"))
+		return false;
+
+	writer.WriteNull().EndRow();
+	writer.Write(1).WriteNull().EndRow();
+
+	if (!writer.Close())
+		return false;
+
+	sfl::CsvReader reader;
+	reader.SetFileName("writer_test.csv");
+
+	bool bPassed = reader.Load() && reader.GetTotalRows() == 2 &&
+		reader.GetRowSize(0) == 1 && reader.GetValue(0, 0).empty() &&
+		reader.GetRowSize(1) == 2 && reader.GetValue(1, 0) == "1" && reader.GetValue(1, 1).empty();
+
+	std::remove("writer_test.csv");
+
+	return bPassed;
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(WriteChar, "WriteChar");
+	tester.AddTest(WriteBlanksRoundTrip, "WriteBlanksRoundTrip");
+	tester.AddTest(WriteNoQuotesRejects, "WriteNoQuotesRejects");
+	tester.AddTest(WriteNullRoundTrip, "WriteNullRoundTrip");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+#define SFL_DATAFILE
+#define SFL_DATAFILEWATCHER
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <iostream>
+
+// Big string used to go before the last block even if there were no blocks
+bool DocumentBigStringFirst()
+{
+	sfl::DataDocument doc;
+	doc.Root().SetString(std::string(20000, 'x'));
+
+	return doc.Root().String() == std::string(20000, 'x');
+}
+
+// Clear used to keep a block that had only the size of a big string
+bool DocumentBigStringClear()
+{
+	sfl::DataDocument doc;
+	doc["big"].SetString(std::string(20000, 'x'));
+	doc["small"].SetString("small");
+	doc.Clear();
+
+	for (int i = 0; i < 1000; i++)
+		doc[std::to_string(i)].SetString(std::string(100, 'a' + i % 26));
+
+	for (int i = 0; i < 1000; i++)
+	{
+		if (doc[std::to_string(i)].String() != std::string(100, 'a' + i % 26))
+			return false;
+	}
+
+	return true;
+}
+
+// Write used to truncate the file the document still had mapped
+bool DocumentWriteOverSource()
+{
+	{
+		std::ofstream file("document_test.df");
+		file << "Info\n{\n\tName = Alex;\n\tLevel = 1;\n}\n";
+	}
+
+	sfl::DataDocument doc;
+
+	if (!sfl::DataDocument::Read(doc, "document_test.df"))
+		return false;
+
+	doc["Info"]["Level"].SetInt(2);
+
+	if (!sfl::DataDocument::Write(doc, "document_test.df"))
+		return false;
+
+	// Views into the old mapping are still fine
+	if (doc["Info"]["Name"].String() != "Alex")
+		return false;
+
+	sfl::DataDocument docNew;
+
+	if (!sfl::DataDocument::Read(docNew, "document_test.df"))
+		return false;
+
+	bool bPassed = docNew["Info"]["Name"].String() == "Alex" && docNew["Info"]["Level"].Int() == 2;
+
+	docNew.Clear();
+	std::remove("document_test.df");
+
+	return bPassed;
+}
+
+// Numbers used to be parsed and written differently from DataFile,
+// text that isn't a number gave 0 instead of throwing
+bool DocumentNumbersLikeDataFile()
+{
+	sfl::DataDocument doc;
+	sfl::DataFile df;
+
+	doc["Int"].SetInt(-42);
+	df["Int"].SetInt(-42);
+
+	doc["Decimal"].SetDecimal(1.5);
+	df["Decimal"].SetDecimal(1.5);
+
+	doc["Plus"].SetString("+5");
+	df["Plus"].SetString("+5");
+
+	if (doc["Int"].String() != df["Int"].String() || doc["Decimal"].String() != df["Decimal"].String())
+		return false;
+
+	if (doc["Int"].Int() != -42 || doc["Decimal"].Decimal() != 1.5L || doc["Plus"].Int() != df["Plus"].Int())
+		return false;
+
+	doc["Text"].SetString("abc");
+
+	try
+	{
+		doc["Text"].Int();
+	}
+	catch (const std::invalid_argument&)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+bool BinaryRoundTrip()
+{
+	sfl::DataFile df;
+
+	for (int i = 0; i < 100; i++)
+		df["Items"]["item" + std::to_string(99 - i)].SetInt(i);
+
+	df["Info"]["Name"].SetString("Alex");
+	df["Info"]["Scale"].SetDecimal(1.5);
+	df["Info"]["On"].SetBool(true);
+
+	// Const trees, like watcher snapshots, can be written too
+	const sfl::DataFile& dfConst = df;
+
+	if (!sfl::DataFile::WriteBinary(dfConst, "binary_test.dfb"))
+		return false;
+
+	sfl::DataFile dfRead;
+	bool bPassed = sfl::DataFile::ReadBinary(dfRead, "binary_test.dfb") &&
+		dfRead["Items"]["item42"].Int() == 57 && dfRead["Info"]["Name"].String() == "Alex";
+
+	// Find does a binary search over keys that were written unsorted
+	sfl::DataFileView view;
+	bPassed = bPassed && view.Open("binary_test.dfb");
+
+	for (int i = 0; i < 100 && bPassed; i++)
+		bPassed = view["Items"]["item" + std::to_string(i)].Int() == 99 - i;
+
+	bPassed = bPassed && !view["Items"]["item100"] && view["Info"]["Scale"].Decimal() == 1.5L;
+
+	view.Close();
+	std::remove("binary_test.dfb");
+
+	return bPassed;
+}
+
+// Decimals out of the long long range used to be cast anyway,
+// Int() has to throw like stoll does on their text
+bool DecimalOutOfRangeInt()
+{
+	sfl::DataFile df;
+	df["Big"].SetDecimal(1e30);
+	df["Small"].SetDecimal(-2.5);
+
+	auto Throws = [](auto fInt)
+	{
+		try
+		{
+			fInt();
+		}
+		catch (const std::out_of_range&)
+		{
+			return true;
+		}
+
+		return false;
+	};
+
+	if (!Throws([&] { return df["Big"].Int(); }) || df["Small"].Int() != -2)
+		return false;
+
+	if (!sfl::DataFile::WriteBinary(df, "binary_test.dfb"))
+		return false;
+
+	sfl::DataFile dfRead;
+	sfl::DataFileView view;
+
+	bool bPassed = sfl::DataFile::ReadBinary(dfRead, "binary_test.dfb") && view.Open("binary_test.dfb") &&
+		Throws([&] { return dfRead["Big"].Int(); }) && Throws([&] { return view["Big"].Int(); }) &&
+		view["Small"].Int() == -2;
+
+	view.Close();
+	std::remove("binary_test.dfb");
+
+	return bPassed;
+}
+
+// Both entries of the object point to the same bytes
+bool BinarySharedOffsets()
+{
+	std::string sData(sfl::detail::DataBinaryMagic, sizeof(sfl::detail::DataBinaryMagic));
+
+	sData += char(sfl::detail::DataBinaryType::Object);
+	sfl::detail::AppendBinary(sData, (uint32_t)2);
+
+	uint64_t nEntry = sData.size() + 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+	sfl::detail::AppendBinary(sData, nEntry);
+	sfl::detail::AppendBinary(sData, nEntry);
+	sfl::detail::AppendBinary(sData, (uint32_t)0);
+	sfl::detail::AppendBinary(sData, (uint32_t)1);
+
+	sfl::detail::AppendBinary(sData, (uint32_t)1);
+	sData += 'a';
+	sData += char(sfl::detail::DataBinaryType::Int);
+	sfl::detail::AppendBinary(sData, (int64_t)1);
+
+	{
+		std::ofstream file("binary_test.dfb", std::ios::binary);
+		file.write(sData.data(), sData.size());
+	}
+
+	sfl::DataFile df;
+	bool bPassed = !sfl::DataFile::ReadBinary(df, "binary_test.dfb");
+
+	std::remove("binary_test.dfb");
+
+	return bPassed;
+}
+
+// Later part sets the value to an empty text, Merge used to keep the first one
+bool ReadParallelEmptyValue()
+{
+	{
+		std::ofstream file("parallel_test.df");
+		file << "Info\n{\n\ta = 1;\n}\n";
+
+		for (int i = 0; i < 10000; i++)
+			file << "Obj" << i << "\n{\n\tValue = " << i << ";\n}\n";
+
+		file << "Info\n{\n\ta = ;\n}\n";
+	}
+
+	sfl::DataFile df;
+	sfl::DataFile::Read(df, "parallel_test.df");
+
+	sfl::ThreadPool pool(4);
+	sfl::DataFile dfParallel;
+	sfl::DataFile::ReadParallel(dfParallel, "parallel_test.df", pool);
+
+	std::remove("parallel_test.df");
+
+	return df["Info"]["a"].String().empty() && dfParallel["Info"]["a"].String().empty() &&
+		dfParallel.vecObjects.size() == df.vecObjects.size();
+}
+
+bool CachedWriterMarkDirty()
+{
+	sfl::DataFile df;
+	df["Info"]["Name"].SetString("Alex");
+
+	sfl::DataFile::CachedWriter writer;
+	writer.Save(df, "cached_test.df");
+
+	// Goes around the setters, so the object has to be marked
+	sfl::DataFile& dfInfo = df["Info"];
+	dfInfo.mapObjects.emplace("Level", dfInfo.vecObjects.size());
+	dfInfo.vecObjects.push_back({ "Level", sfl::DataFile() });
+	dfInfo.MarkDirty();
+
+	writer.Save(df, "cached_test.df");
+
+	sfl::DataFile dfRead;
+	sfl::DataFile::Read(dfRead, "cached_test.df");
+
+	std::remove("cached_test.df");
+
+	return dfRead["Info"].HasProperty("Level");
+}
+
+// Callbacks used to be called with the reload lock held,
+// so reloading from a callback locked forever
+bool WatcherReloadInCallback()
+{
+	{
+		std::ofstream file("watcher_test.df");
+		file << "Level = 1;\n";
+	}
+
+	sfl::DataFileWatcher watcher;
+
+	if (!watcher.Start("watcher_test.df"))
+		return false;
+
+	std::atomic<int> nCalls = 0;
+
+	watcher.OnChange("Level", [&](const sfl::DataFile&, const std::vector<sfl::DataFileWatcher::Change>&)
+		{
+			if (nCalls++ == 0)
+				watcher.Reload();
+		});
+
+	{
+		std::ofstream file("watcher_test.df");
+		file << "Level = 2;\n";
+	}
+
+	bool bPassed = watcher.Reload() && watcher.Get()->Find("Level") && watcher.Get()->Find("Level")->Int() == 2;
+
+	watcher.Stop();
+	std::remove("watcher_test.df");
+
+	return bPassed && nCalls > 0;
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(DocumentBigStringFirst, "DocumentBigStringFirst");
+	tester.AddTest(DocumentBigStringClear, "DocumentBigStringClear");
+	tester.AddTest(DocumentWriteOverSource, "DocumentWriteOverSource");
+	tester.AddTest(DocumentNumbersLikeDataFile, "DocumentNumbersLikeDataFile");
+	tester.AddTest(BinaryRoundTrip, "BinaryRoundTrip");
+	tester.AddTest(DecimalOutOfRangeInt, "DecimalOutOfRangeInt");
+	tester.AddTest(BinarySharedOffsets, "BinarySharedOffsets");
+	tester.AddTest(ReadParallelEmptyValue, "ReadParallelEmptyValue");
+	tester.AddTest(CachedWriterMarkDirty, "CachedWriterMarkDirty");
+	tester.AddTest(WatcherReloadInCallback, "WatcherReloadInCallback");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
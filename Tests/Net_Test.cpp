@@ -0,0 +1,364 @@
+#define SFL_NET
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace def::net;
+
+enum class TestMsg : uint32_t
+{
+	Big,
+	Small
+};
+
+// Polls until fDone returns true or about 5 seconds pass
+template <typename F>
+bool WaitFor(F fDone)
+{
+	for (int i = 0; i < 500; i++)
+	{
+		if (fDone())
+			return true;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	return fDone();
+}
+
+class LaneServer : public server<TestMsg>
+{
+public:
+	LaneServer(uint16_t port) : server<TestMsg>(port) {}
+
+	bool OnClientConnect(std::shared_ptr<connection<TestMsg>>) override
+	{
+		return true;
+	}
+
+	void OnMessage(std::shared_ptr<connection<TestMsg>>, message<TestMsg>& msg) override
+	{
+		int nOrder = m_nOrder++;
+
+		if (msg.header.id == TestMsg::Big)
+		{
+			m_nBigAt = nOrder;
+			m_bBigIntact = msg.body.size() == 8 * 1024 * 1024 && msg.header.size == msg.body.size();
+
+			for (size_t i = 0; m_bBigIntact && i < msg.body.size(); i += 4093)
+				m_bBigIntact = msg.body[i] == uint8_t(i % 251);
+		}
+		else
+		{
+			int nValue = 0;
+			msg >> nValue;
+
+			m_nSmallAt = nOrder;
+			m_nSmallValue = nValue;
+		}
+	}
+
+public:
+	std::atomic<int> m_nOrder = 0;
+	std::atomic<int> m_nBigAt = -1;
+	std::atomic<int> m_nSmallAt = -1;
+	std::atomic<int> m_nSmallValue = 0;
+	std::atomic<bool> m_bBigIntact = false;
+
+};
+
+// 8 MiB body goes in chunks on the bulk lane,
+// so the high lane message gets in between them
+bool PriorityLanes()
+{
+	LaneServer srv(60201);
+	srv.start();
+
+	client<TestMsg> cl;
+	cl.connect("127.0.0.1", 60201);
+
+	if (!WaitFor([&] { return cl.connected(); }))
+		return false;
+
+	message<TestMsg> msgBig;
+	msgBig.header.id = TestMsg::Big;
+	msgBig.body.resize(8 * 1024 * 1024);
+
+	for (size_t i = 0; i < msgBig.body.size(); i++)
+		msgBig.body[i] = uint8_t(i % 251);
+
+	msgBig.header.size = msgBig.body.size();
+
+	message<TestMsg> msgSmall;
+	msgSmall.header.id = TestMsg::Small;
+	msgSmall << 42;
+
+	cl.send(msgBig, lane::bulk);
+	cl.send(msgSmall, lane::high);
+
+	bool bArrived = WaitFor([&] { srv.update(); return srv.m_nOrder == 2; });
+
+	cl.disconnect();
+	srv.stop();
+
+	return bArrived && srv.m_bBigIntact && srv.m_nSmallValue == 42 && srv.m_nSmallAt < srv.m_nBigAt;
+}
+
+class StreamServer : public server<TestMsg>
+{
+public:
+	StreamServer(uint16_t port) : server<TestMsg>(port) {}
+
+	bool OnClientConnect(std::shared_ptr<connection<TestMsg>>) override
+	{
+		return true;
+	}
+
+	void OnMessage(std::shared_ptr<connection<TestMsg>>, message<TestMsg>&) override
+	{
+		m_nMessages++;
+	}
+
+	// Runs on the I/O thread
+	void OnStreamChunk(std::shared_ptr<connection<TestMsg>>, const stream_chunk<TestMsg>& chunk) override
+	{
+		if (chunk.first != (chunk.offset == 0) || chunk.offset != m_nReceived)
+			m_bInOrder = false;
+
+		for (size_t i = 0; i < chunk.size; i++)
+		{
+			if (chunk.data[i] != uint8_t((chunk.offset + i) % 251))
+				m_bInOrder = false;
+		}
+
+		m_nReceived += chunk.size;
+
+		if (chunk.last)
+			m_bLast = true;
+	}
+
+public:
+	std::atomic<uint64_t> m_nReceived = 0;
+	std::atomic<bool> m_bInOrder = true;
+	std::atomic<bool> m_bLast = false;
+	std::atomic<int> m_nMessages = 0;
+
+};
+
+// 1 MB body is pulled from the source in parts and
+// arrives in order without a whole message in memory
+bool StreamBody()
+{
+	StreamServer srv(60202);
+	srv.start();
+
+	client<TestMsg> cl;
+	cl.connect("127.0.0.1", 60202);
+
+	if (!WaitFor([&] { return cl.connected(); }))
+		return false;
+
+	const uint64_t nTotal = 1000 * 1000;
+	uint64_t nSent = 0;
+
+	cl.send_stream(TestMsg::Big,
+		[&](uint8_t* pBuffer, size_t nSize)
+		{
+			size_t nCount = (size_t)std::min<uint64_t>(nSize, nTotal - nSent);
+
+			for (size_t i = 0; i < nCount; i++)
+				pBuffer[i] = uint8_t((nSent + i) % 251);
+
+			nSent += nCount;
+			return nCount;
+		});
+
+	bool bArrived = WaitFor([&] { return srv.m_bLast.load(); });
+
+	cl.disconnect();
+	srv.stop();
+
+	return bArrived && srv.m_bInOrder && srv.m_nReceived == nTotal && srv.m_nMessages == 0;
+}
+
+// Frame bigger than the limit closes the connection
+// before anything is allocated for its body
+bool MaxSizeRejected()
+{
+	StreamServer srv(60203);
+	srv.set_max_message_size(1024);
+	srv.start();
+
+	client<TestMsg> cl;
+	cl.connect("127.0.0.1", 60203);
+
+	if (!WaitFor([&] { return cl.connected(); }))
+		return false;
+
+	message<TestMsg> msgSmall;
+	msgSmall.header.id = TestMsg::Small;
+	msgSmall.body.resize(512);
+
+	message<TestMsg> msgBig;
+	msgBig.header.id = TestMsg::Big;
+	msgBig.body.resize(4096);
+
+	cl.send(msgSmall);
+	cl.send(msgBig);
+
+	bool bDropped = WaitFor([&] { srv.update(); return !cl.connected(); });
+	srv.update();
+
+	cl.disconnect();
+	srv.stop();
+
+	return bDropped && srv.m_nMessages == 1;
+}
+
+#ifdef ASIO_HAS_CO_AWAIT
+class EchoServer : public server<TestMsg>
+{
+public:
+	EchoServer(uint16_t port) : server<TestMsg>(port)
+	{
+		use_sessions();
+	}
+
+	bool OnClientConnect(std::shared_ptr<connection<TestMsg>>) override
+	{
+		return true;
+	}
+
+	// Sends every number back doubled
+	asio::awaitable<void> OnSession(std::shared_ptr<connection<TestMsg>> client) override
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			message<TestMsg> msg = co_await client->read();
+
+			int nValue = 0;
+			msg >> nValue;
+
+			message<TestMsg> msgReply;
+			msgReply.header.id = TestMsg::Small;
+			msgReply << nValue * 2;
+
+			co_await client->write(msgReply, lane::high);
+		}
+	}
+
+};
+
+// Both sides talk through coroutines, nothing goes to update()
+bool CoroutineSession()
+{
+	EchoServer srv(60204);
+	srv.start();
+
+	client<TestMsg> cl;
+	std::atomic<int> nReplies = 0;
+	std::atomic<bool> bCorrect = true;
+
+	cl.spawn([&]() -> asio::awaitable<void>
+		{
+			if (!co_await cl.connect_async("127.0.0.1", 60204))
+				co_return;
+
+			for (int i = 1; i <= 3; i++)
+			{
+				message<TestMsg> msg;
+				msg.header.id = TestMsg::Small;
+				msg << i;
+
+				co_await cl.write(msg);
+
+				message<TestMsg> msgReply = co_await cl.read();
+
+				int nValue = 0;
+				msgReply >> nValue;
+
+				if (nValue != i * 2)
+					bCorrect = false;
+
+				nReplies++;
+			}
+		});
+
+	bool bDone = WaitFor([&] { return nReplies == 3; });
+
+	cl.disconnect();
+	srv.stop();
+
+	return bDone && bCorrect && srv.incoming().empty();
+}
+#endif
+
+// Padding of records goes to the file, so it must be zeros
+// and not whatever was on the stack
+bool CaptureRecordPadding()
+{
+	enum class ShortMsg : uint16_t { Ping };
+
+	{
+		capture<ShortMsg> cap;
+
+		if (!cap.open("net_test.cap", 1024))
+			return false;
+
+		message<ShortMsg> msg;
+		msg.header.id = ShortMsg::Ping;
+		msg << 7;
+
+		cap.record(capture_direction::inbound, 3, msg);
+	}
+
+	bool bPassed = true;
+
+	{
+		sfl::MappedFile file;
+
+		if (!file.Open("net_test.cap") || file.Size() < sizeof(capture_file_header) + sizeof(capture_record<ShortMsg>))
+			return false;
+
+		const char* pRecord = file.Data() + sizeof(capture_file_header);
+		constexpr size_t nHeader = offsetof(capture_record<ShortMsg>, header);
+
+		// Bytes between direction and header, and between id and size
+		for (size_t i = offsetof(capture_record<ShortMsg>, direction) + sizeof(capture_direction); i < nHeader; i++)
+			bPassed = bPassed && pRecord[i] == 0;
+
+		for (size_t i = nHeader + sizeof(ShortMsg); i < nHeader + offsetof(message_header<ShortMsg>, size); i++)
+			bPassed = bPassed && pRecord[i] == 0;
+
+		capture_reader<ShortMsg> reader;
+		capture_entry<ShortMsg> entry;
+
+		bPassed = bPassed && reader.open("net_test.cap") && reader.next(entry) &&
+			entry.record.connection == 3 && entry.msg.header.id == ShortMsg::Ping && entry.msg.body.size() == sizeof(int);
+	}
+
+	std::remove("net_test.cap");
+
+	return bPassed;
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(PriorityLanes, "PriorityLanes");
+	tester.AddTest(StreamBody, "StreamBody");
+	tester.AddTest(MaxSizeRejected, "MaxSizeRejected");
+	tester.AddTest(CaptureRecordPadding, "CaptureRecordPadding");
+
+#ifdef ASIO_HAS_CO_AWAIT
+	tester.AddTest(CoroutineSession, "CoroutineSession");
+#endif
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#define SFL_NET
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <memory>
+#include <thread>
+
+using def::net::spsc_ring;
+
+bool CapacityRounding()
+{
+	return spsc_ring<int>(1).capacity() == 1 && spsc_ring<int>(5).capacity() == 8 &&
+		spsc_ring<int>(64).capacity() == 64 && spsc_ring<int>(65).capacity() == 128;
+}
+
+// Push fails when full and leaves the value alone,
+// the order holds after the indices wrap around
+bool FullAndEmpty()
+{
+	spsc_ring<int> ring(4);
+
+	if (!ring.empty() || ring.front() != nullptr || ring.pop_front())
+		return false;
+
+	for (int round = 0; round < 10; round++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (!ring.push_back(round * 4 + i))
+				return false;
+		}
+
+		if (ring.push_back(-1) || ring.size() != 4)
+			return false;
+
+		for (int i = 0; i < 4; i++)
+		{
+			int n = -1;
+
+			if (!ring.pop_front(n) || n != round * 4 + i)
+				return false;
+		}
+
+		if (!ring.empty())
+			return false;
+	}
+
+	return true;
+}
+
+// Move-only values, the ones left in the ring are destroyed with it
+bool MoveOnlyDestroyed()
+{
+	auto pCounter = std::make_shared<int>(0);
+
+	{
+		spsc_ring<std::unique_ptr<std::shared_ptr<int>>> ring(8);
+
+		for (int i = 0; i < 6; i++)
+			ring.emplace_back(std::make_unique<std::shared_ptr<int>>(pCounter));
+
+		auto pFull = std::make_unique<std::shared_ptr<int>>(pCounter);
+
+		if (!ring.push_back(std::move(pFull)) || !ring.emplace_back(std::make_unique<std::shared_ptr<int>>(pCounter)))
+			return false;
+
+		pFull = std::make_unique<std::shared_ptr<int>>(pCounter);
+
+		// Full ring doesn't take the value
+		if (ring.push_back(std::move(pFull)) || !pFull)
+			return false;
+
+		pFull.reset();
+
+		std::unique_ptr<std::shared_ptr<int>> pOut;
+
+		if (!ring.pop_front(pOut) || !pOut || !ring.pop_front() || pCounter.use_count() != 8)
+			return false;
+	}
+
+	return pCounter.use_count() == 1;
+}
+
+// One producer and one consumer on a small ring,
+// everything arrives once and in order
+bool ProducerConsumer()
+{
+	constexpr size_t nTotal = 1000000;
+
+	spsc_ring<size_t> ring(64);
+
+	std::thread thProducer([&]
+		{
+			for (size_t i = 0; i < nTotal; i++)
+			{
+				while (!ring.push_back(i))
+					std::this_thread::yield();
+			}
+		});
+
+	bool bInOrder = true;
+	size_t nExpected = 0;
+
+	while (nExpected < nTotal)
+	{
+		size_t n = 0;
+
+		if (!ring.pop_front(n))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		if (n != nExpected)
+			bInOrder = false;
+
+		nExpected++;
+	}
+
+	thProducer.join();
+
+	return bInOrder && ring.empty();
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(CapacityRounding, "CapacityRounding");
+	tester.AddTest(FullAndEmpty, "FullAndEmpty");
+	tester.AddTest(MoveOnlyDestroyed, "MoveOnlyDestroyed");
+	tester.AddTest(ProducerConsumer, "ProducerConsumer");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#define SFL_NET
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using def::net::ts_deque;
+
+// Range goes in with its order, elements are moved
+bool PushRangeDrain()
+{
+	ts_deque<std::unique_ptr<int>> deq;
+	std::vector<std::unique_ptr<int>> vecIn;
+
+	for (int i = 0; i < 1000; i++)
+		vecIn.push_back(std::make_unique<int>(i));
+
+	deq.push_range(vecIn);
+
+	if (deq.size() != 1000 || vecIn[0] != nullptr)
+		return false;
+
+	std::vector<std::unique_ptr<int>> vecOut;
+
+	if (deq.drain_into(vecOut, 300) != 300 || vecOut.size() != 300 || deq.size() != 700)
+		return false;
+
+	for (int i = 0; i < 300; i++)
+	{
+		if (*vecOut[i] != i)
+			return false;
+	}
+
+	// The rest, max is bigger than what's left
+	return deq.drain_into(vecOut) == 700 && deq.empty() && *vecOut.back() == 999;
+}
+
+bool TryPop()
+{
+	ts_deque<int> deq;
+
+	if (deq.try_pop().has_value())
+		return false;
+
+	deq.push_back(1);
+	deq.push_back(2);
+
+	auto first = deq.try_pop();
+	auto second = deq.try_pop();
+
+	return first == 1 && second == 2 && !deq.try_pop().has_value();
+}
+
+// Timeout when nothing comes and an early wake up when something does
+bool WaitForTimeout()
+{
+	ts_deque<int> deq;
+
+	auto tpStart = std::chrono::steady_clock::now();
+
+	if (deq.wait_for(std::chrono::milliseconds(30)))
+		return false;
+
+	if (std::chrono::steady_clock::now() - tpStart < std::chrono::milliseconds(30))
+		return false;
+
+	std::thread thProducer([&]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			deq.push_back(5);
+		});
+
+	tpStart = std::chrono::steady_clock::now();
+	bool bArrived = deq.wait_for(std::chrono::seconds(10));
+	auto tWaited = std::chrono::steady_clock::now() - tpStart;
+
+	thProducer.join();
+
+	return bArrived && tWaited < std::chrono::seconds(5) && deq.pop_front() == 5;
+}
+
+// Batches from several producers all reach a consumer that blocks
+bool WaitPopProducers()
+{
+	constexpr int nProducers = 4;
+	constexpr int nBatches = 250;
+	constexpr int nBatchSize = 100;
+
+	ts_deque<int> deq;
+	std::vector<std::thread> vecProducers;
+
+	for (int p = 0; p < nProducers; p++)
+	{
+		vecProducers.emplace_back([&deq, p]
+			{
+				std::vector<int> vecBatch(nBatchSize);
+
+				for (int b = 0; b < nBatches; b++)
+				{
+					for (int i = 0; i < nBatchSize; i++)
+						vecBatch[i] = (p * nBatches + b) * nBatchSize + i;
+
+					deq.push_range(vecBatch.begin(), vecBatch.end());
+				}
+			});
+	}
+
+	constexpr int nTotal = nProducers * nBatches * nBatchSize;
+
+	std::vector<bool> vecSeen(nTotal, false);
+	std::vector<int> vecBatch;
+	int nReceived = 0;
+	bool bValid = true;
+
+	auto Take = [&](int n)
+	{
+		if (n < 0 || n >= nTotal || vecSeen[n])
+			bValid = false;
+		else
+			vecSeen[n] = true;
+
+		nReceived++;
+	};
+
+	while (nReceived < nTotal)
+	{
+		Take(deq.wait_pop());
+
+		vecBatch.clear();
+		deq.drain_into(vecBatch, 64);
+
+		for (int n : vecBatch)
+			Take(n);
+	}
+
+	for (auto& th : vecProducers)
+		th.join();
+
+	return bValid && deq.empty();
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(PushRangeDrain, "PushRangeDrain");
+	tester.AddTest(TryPop, "TryPop");
+	tester.AddTest(WaitForTimeout, "WaitForTimeout");
+	tester.AddTest(WaitPopProducers, "WaitPopProducers");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}
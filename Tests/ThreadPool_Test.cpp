@@ -0,0 +1,241 @@
+#define SFL_THREADPOOL
+#define SFL_TESTER
+#include "SFL.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using sfl::detail::Task;
+using sfl::detail::WorkStealingDeque;
+
+// Owner takes its tasks from the bottom, thieves from the top,
+// and the array grows past its first 64 slots
+bool DequeOrder()
+{
+	std::vector<Task> vecTasks(1000);
+	WorkStealingDeque deq;
+
+	for (auto& task : vecTasks)
+		deq.Push(&task);
+
+	if (deq.Pop() != &vecTasks[999] || deq.Steal() != &vecTasks[0])
+		return false;
+
+	for (size_t i = 998; i >= 500; i--)
+	{
+		if (deq.Pop() != &vecTasks[i])
+			return false;
+	}
+
+	for (size_t i = 1; i < 500; i++)
+	{
+		if (deq.Steal() != &vecTasks[i])
+			return false;
+	}
+
+	return deq.Pop() == nullptr && deq.Steal() == nullptr;
+}
+
+// The owner pushes and pops while thieves steal,
+// every task must be taken exactly once
+bool DequeConcurrentSteal()
+{
+	constexpr size_t nTasks = 200000;
+	constexpr size_t nThieves = 3;
+
+	std::vector<Task> vecTasks(nTasks);
+	std::vector<std::atomic<int>> vecTaken(nTasks);
+
+	WorkStealingDeque deq;
+	std::atomic<bool> bDone = false;
+
+	auto Take = [&](Task* pTask)
+	{
+		vecTaken[size_t(pTask - vecTasks.data())]++;
+	};
+
+	std::vector<std::thread> vecThieves;
+
+	for (size_t i = 0; i < nThieves; i++)
+	{
+		vecThieves.emplace_back([&]
+			{
+				while (!bDone)
+				{
+					if (Task* pTask = deq.Steal())
+						Take(pTask);
+				}
+
+				while (Task* pTask = deq.Steal())
+					Take(pTask);
+			});
+	}
+
+	for (size_t i = 0; i < nTasks; i++)
+	{
+		deq.Push(&vecTasks[i]);
+
+		// Pop sometimes, so the owner races thieves for the last task
+		if (i % 3 == 0)
+		{
+			if (Task* pTask = deq.Pop())
+				Take(pTask);
+		}
+	}
+
+	while (Task* pTask = deq.Pop())
+		Take(pTask);
+
+	bDone = true;
+
+	for (auto& th : vecThieves)
+		th.join();
+
+	for (auto& n : vecTaken)
+	{
+		if (n != 1)
+			return false;
+	}
+
+	return true;
+}
+
+bool SubmitResults()
+{
+	sfl::ThreadPool pool(4);
+	std::vector<sfl::TaskHandle<size_t>> vecHandles;
+
+	for (size_t i = 0; i < 1000; i++)
+		vecHandles.push_back(pool.Submit([i]() { return i * i; }));
+
+	size_t nSum = 0;
+
+	for (auto& handle : vecHandles)
+		nSum += handle.Get();
+
+	return nSum == 332833500;
+}
+
+bool SubmitException()
+{
+	sfl::ThreadPool pool(2);
+
+	auto handle = pool.Submit([]() -> int { throw std::runtime_error("task"); });
+
+	try
+	{
+		handle.Get();
+	}
+	catch (const std::runtime_error& e)
+	{
+		return std::string(e.what()) == "task";
+	}
+
+	return false;
+}
+
+bool ParallelForCoversAll()
+{
+	sfl::ThreadPool pool(4);
+
+	for (size_t nGrain : { 0, 1, 7, 5000 })
+	{
+		std::vector<std::atomic<int>> vecHits(10000);
+
+		pool.ParallelFor(100, 10000, [&](size_t i) { vecHits[i]++; }, nGrain);
+
+		for (size_t i = 0; i < vecHits.size(); i++)
+		{
+			if (vecHits[i] != (i >= 100 ? 1 : 0))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// Wait rethrows the first exception, and the other tasks still run
+bool TaskGroupException()
+{
+	sfl::ThreadPool pool(4);
+	sfl::TaskGroup group(pool);
+
+	std::atomic<int> nRan = 0;
+
+	for (int i = 0; i < 100; i++)
+	{
+		group.Run([&nRan, i]()
+			{
+				nRan++;
+
+				if (i == 50)
+					throw std::runtime_error("group");
+			});
+	}
+
+	bool bThrown = false;
+
+	try
+	{
+		group.Wait();
+	}
+	catch (const std::runtime_error& e)
+	{
+		bThrown = std::string(e.what()) == "group";
+	}
+
+	return bThrown && nRan == 100 && group.Done();
+}
+
+// Every worker waits for tasks of its own inside a task,
+// so that only finishes if waiting runs other tasks
+bool NestedWaits()
+{
+	sfl::ThreadPool pool(2);
+
+	auto future = std::async(std::launch::async, [&pool]()
+		{
+			std::atomic<size_t> nSum = 0;
+
+			pool.ParallelFor(0, 16, [&](size_t i)
+				{
+					pool.ParallelFor(0, 100, [&](size_t j) { nSum += i * 100 + j; }, 1);
+
+					auto handle = pool.Submit([i]() { return i; });
+					nSum += handle.Get();
+				}, 1);
+
+			return nSum.load();
+		});
+
+	if (future.wait_for(std::chrono::seconds(30)) != std::future_status::ready)
+	{
+		// Deadlocked, the pool can't be destroyed now
+		std::terminate();
+	}
+
+	// Sum of all i * 100 + j, and of all i from the submitted tasks
+	return future.get() == 1599 * 1600 / 2 + 15 * 16 / 2;
+}
+
+int main()
+{
+	sfl::Tester tester;
+
+	tester.AddTest(DequeOrder, "DequeOrder");
+	tester.AddTest(DequeConcurrentSteal, "DequeConcurrentSteal");
+	tester.AddTest(SubmitResults, "SubmitResults");
+	tester.AddTest(SubmitException, "SubmitException");
+	tester.AddTest(ParallelForCoversAll, "ParallelForCoversAll");
+	tester.AddTest(TaskGroupException, "TaskGroupException");
+	tester.AddTest(NestedWaits, "NestedWaits");
+
+	tester.StartTests();
+
+	return tester.WaitTests() ? 0 : 1;
+}